@@ -0,0 +1,383 @@
+#ifndef SP_CONCURRENT_AWAITABLE_BITSET_H
+#define SP_CONCURRENT_AWAITABLE_BITSET_H
+
+#include "Bitset.h"
+#include <atomic>
+#include <cstddef>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+
+namespace sp {
+
+/**
+ * Coroutine front of a shared Bitset used as a resource pool.
+ * `co_await pool.acquire(set)` swaps the first bit to $set, and if there is
+ * none suspends the coroutine in a FIFO of waiters until a bit is released
+ * with `pool.set(idx, !set)`. A released bit is handed directly to the oldest
+ * waiter without changing the bitset or scanning it, and the waiter is resumed
+ * on the executor it was acquired with.
+ *
+ * Waiters are resumed after the releasing thread is done draining. Waiters
+ * without an executor are resumed on the releasing thread through a per
+ * thread trampoline, so a resumed coroutine which releases a bit in turn only
+ * queues the next waiter and the stack does not grow with the number of
+ * waiters.
+ *
+ * Waiters are intrusive nodes stored in the awaiter, so waiting never
+ * allocates. The waiter list is drained by whichever thread first requests a
+ * drain, concurrent releasers and waiters only register their request with
+ * the draining thread, so nobody blocks on anybody else.
+ *
+ * Waiters are only served by operations on the pool. Bits released directly
+ * on the underlying Bitset are not noticed by queued waiters until the next
+ * acquire() or set() on the pool.
+ *
+ * An executor is any type with `void post(std::coroutine_handle<>)`.
+ */
+template <typename Bitset_t>
+class AwaitableBitset {
+public:
+  static constexpr size_t npos = Bitset_t::npos;
+
+private:
+  struct Waiter {
+    Waiter *next = nullptr;
+    std::coroutine_handle<> handle = nullptr;
+    size_t idx = npos;
+    void *executor = nullptr;
+    void (*post)(void *, std::coroutine_handle<>) = nullptr;
+  };
+
+  /* the waiters for bits to be swapped to one of the values */
+  struct Queue {
+    // pushed waiters, newest first
+    std::atomic<Waiter *> incoming{nullptr};
+    // waiters pushed and not yet served
+    std::atomic<size_t> waiting{0};
+    // drain requests, the thread which increments it from 0 drains
+    std::atomic<size_t> drain{0};
+    // waiters in arrival order, only accessed by the draining thread
+    Waiter *head = nullptr;
+    Waiter *tail = nullptr;
+  };
+
+  /* served waiters in the order they are to be resumed */
+  struct Batch {
+    Waiter *head = nullptr;
+    Waiter *tail = nullptr;
+  };
+
+  /* the waiters to resume inline on this thread */
+  struct Trampoline {
+    Batch ready;
+    bool running = false;
+  };
+
+  Bitset_t &m_bitset;
+  Queue m_queues[2];
+
+public:
+  class Awaiter {
+  private:
+    AwaitableBitset &m_pool;
+    const bool m_set;
+    Waiter m_waiter;
+
+  public:
+    Awaiter(AwaitableBitset &pool, bool set, void *executor,
+            void (*post)(void *, std::coroutine_handle<>)) noexcept
+        : m_pool(pool)
+        , m_set(set)
+        , m_waiter() {
+      m_waiter.executor = executor;
+      m_waiter.post = post;
+    }
+
+    bool
+    await_ready() noexcept {
+      // older waiters are served first
+      if (m_pool.waiting(m_set) != 0) {
+        return false;
+      }
+      m_waiter.idx = m_pool.m_bitset.swap_first(m_set);
+      return m_waiter.idx != npos;
+    }
+
+    /**
+     * after the waiter is pushed it can be resumed by another thread at any
+     * time, so the awaiter is not touched after that unless this thread
+     * served the waiter itself
+     */
+    bool
+    await_suspend(std::coroutine_handle<> handle) noexcept {
+      m_waiter.handle = handle;
+      return !m_pool.wait(m_set, &m_waiter);
+    }
+
+    size_t
+    await_resume() const noexcept {
+      return m_waiter.idx;
+    }
+  };
+
+  explicit AwaitableBitset(Bitset_t &bitset) noexcept //
+      : m_bitset(bitset)
+      , m_queues() {
+  }
+
+  AwaitableBitset(const AwaitableBitset &) = delete;
+  AwaitableBitset(AwaitableBitset &&) = delete;
+
+  AwaitableBitset &
+  operator=(const AwaitableBitset &) = delete;
+  AwaitableBitset &
+  operator=(AwaitableBitset &&) = delete;
+
+  /**
+   *  @brief awaits a bit swapped to $set, resuming inline on the thread
+   *         which released the bit once it is done draining
+   *  @return awaiter resulting in the index of the acquired bit
+   */
+  Awaiter
+  acquire(bool set) noexcept {
+    return Awaiter(*this, set, nullptr, nullptr);
+  }
+
+  /**
+   *  @brief awaits a bit swapped to $set, resuming on $executor
+   */
+  template <typename Executor>
+  Awaiter
+  acquire(bool set, Executor &executor) noexcept {
+    return Awaiter(*this, set, &executor,
+                   [](void *e, std::coroutine_handle<> handle) {
+                     static_cast<Executor *>(e)->post(handle);
+                   });
+  }
+
+  /**
+   *  @brief sets the bit at $bitIdx to $b. if there are coroutines waiting
+   *         to acquire(!b) and the bit is held, that is !b, it is instead
+   *         handed to the oldest of them
+   *  @return true if the bit was changed or handed off
+   */
+  bool
+  set(size_t bitIdx, bool b) noexcept {
+    Queue &q = queue(!b);
+    // a bit which is allready $b could be claimed by anybody
+    if (q.waiting.load() != 0 && bitIdx < m_bitset.size() &&
+        m_bitset.test(bitIdx) != b) {
+      size_t idle(0);
+      if (q.drain.compare_exchange_strong(idle, 1)) {
+        gather(q);
+        Waiter *waiter = pop(q);
+        Batch served;
+        if (waiter != nullptr) {
+          waiter->idx = bitIdx;
+          push(served, waiter);
+        }
+        finish(q, !b, nullptr, served);
+        post(served);
+        if (waiter != nullptr) {
+          return true;
+        }
+      }
+    }
+
+    const bool result = m_bitset.set(bitIdx, b);
+    /**
+     * a waiter which registered after our load of $waiting will find the bit
+     * when it drains, otherwise we request a drain here
+     */
+    if (q.waiting.load() != 0) {
+      request(q, !b, nullptr);
+    }
+    return result;
+  }
+
+  bool
+  test(size_t bitIdx) const noexcept {
+    return m_bitset.test(bitIdx);
+  }
+
+  /**
+   *  @return the number of waiters for bits swapped to $set
+   */
+  size_t
+  waiting(bool set) const noexcept {
+    return m_queues[set ? 1 : 0].waiting.load();
+  }
+
+private:
+  static void
+  push(Batch &batch, Waiter *waiter) noexcept {
+    waiter->next = nullptr;
+    if (batch.tail != nullptr) {
+      batch.tail->next = waiter;
+    } else {
+      batch.head = waiter;
+    }
+    batch.tail = waiter;
+  }
+
+  static Trampoline &
+  trampoline() noexcept {
+    thread_local Trampoline result;
+    return result;
+  }
+
+  /**
+   * resumes the waiters of $batch in order. inline waiters are queued on the
+   * trampoline of this thread, which is run unless this thread is allready
+   * running it further up the stack
+   */
+  static void
+  post(Batch &batch) {
+    Trampoline &t = trampoline();
+    while (batch.head != nullptr) {
+      Waiter *waiter = batch.head;
+      batch.head = waiter->next;
+      if (waiter->post != nullptr) {
+        waiter->post(waiter->executor, waiter->handle);
+      } else {
+        push(t.ready, waiter);
+      }
+    }
+    batch.tail = nullptr;
+
+    if (t.running) {
+      return;
+    }
+    t.running = true;
+    while (t.ready.head != nullptr) {
+      Waiter *waiter = t.ready.head;
+      t.ready.head = waiter->next;
+      if (t.ready.head == nullptr) {
+        t.ready.tail = nullptr;
+      }
+      // the waiter is owned by the coroutine and gone once resumed
+      waiter->handle.resume();
+    }
+    t.running = false;
+  }
+
+  Queue &
+  queue(bool set) noexcept {
+    return m_queues[set ? 1 : 0];
+  }
+
+  /**
+   * registers $self as waiting for a bit swapped to $set
+   * returns true if this thread served $self itself and it should not suspend
+   */
+  bool
+  wait(bool set, Waiter *self) noexcept {
+    Queue &q = queue(set);
+    q.waiting.fetch_add(1);
+
+    Waiter *head = q.incoming.load();
+    do {
+      self->next = head;
+    } while (!q.incoming.compare_exchange_weak(head, self));
+
+    return request(q, set, self);
+  }
+
+  /**
+   * requests a drain, draining if no other thread is
+   * returns true if $self was served
+   */
+  bool
+  request(Queue &q, bool set, Waiter *self) noexcept {
+    if (q.drain.fetch_add(1) != 0) {
+      return false;
+    }
+    Batch served;
+    bool self_served = serve(q, set, self, served);
+    self_served |= finish(q, set, self, served);
+    post(served);
+    return self_served;
+  }
+
+  /**
+   * gives up draining, draining again if there were requests since
+   * returns true if $self was served
+   */
+  bool
+  finish(Queue &q, bool set, Waiter *self, Batch &served) noexcept {
+    bool self_served = false;
+    size_t seen(1);
+    while (!q.drain.compare_exchange_strong(seen, 0)) {
+      // $seen is updated to the current requests
+      self_served |= serve(q, set, self, served);
+    }
+    return self_served;
+  }
+
+  /**
+   * serves the waiters in arrival order while there are bits to swap,
+   * appending them to $served to be resumed once draining is done
+   * returns true if $self was served
+   */
+  bool
+  serve(Queue &q, bool set, Waiter *self, Batch &served) noexcept {
+    bool self_served = false;
+    gather(q);
+    while (q.head != nullptr) {
+      const size_t idx = m_bitset.swap_first(set);
+      if (idx == npos) {
+        break;
+      }
+      Waiter *waiter = pop(q);
+      waiter->idx = idx;
+      if (waiter == self) {
+        self_served = true;
+      } else {
+        push(served, waiter);
+      }
+    }
+    return self_served;
+  }
+
+  /* moves the pushed waiters to the end of the FIFO */
+  static void
+  gather(Queue &q) noexcept {
+    Waiter *pushed = q.incoming.exchange(nullptr);
+    Waiter *ordered = nullptr;
+    Waiter *last = pushed;
+    while (pushed != nullptr) {
+      Waiter *next = pushed->next;
+      pushed->next = ordered;
+      ordered = pushed;
+      pushed = next;
+    }
+    if (ordered == nullptr) {
+      return;
+    }
+    if (q.tail != nullptr) {
+      q.tail->next = ordered;
+    } else {
+      q.head = ordered;
+    }
+    q.tail = last;
+  }
+
+  static Waiter *
+  pop(Queue &q) noexcept {
+    Waiter *waiter = q.head;
+    if (waiter != nullptr) {
+      q.head = waiter->next;
+      if (q.head == nullptr) {
+        q.tail = nullptr;
+      }
+      q.waiting.fetch_sub(1);
+    }
+    return waiter;
+  }
+};
+
+} // namespace sp
+
+#endif
+#endif
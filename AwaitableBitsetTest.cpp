@@ -0,0 +1,238 @@
+#include "AwaitableBitset.h"
+#include "gtest/gtest.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+using sp::AwaitableBitset;
+using sp::Bitset;
+
+class AwaitableBitsetTest : public ::testing::Test {};
+
+/* eagerly started coroutine which destroys itself when done */
+struct Task {
+  struct promise_type {
+    Task
+    get_return_object() noexcept {
+      return {};
+    }
+
+    std::suspend_never
+    initial_suspend() noexcept {
+      return {};
+    }
+
+    std::suspend_never
+    final_suspend() noexcept {
+      return {};
+    }
+
+    void
+    return_void() noexcept {
+    }
+
+    void
+    unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+struct QueueExecutor {
+  std::deque<std::coroutine_handle<>> m_ready;
+
+  void
+  post(std::coroutine_handle<> handle) {
+    m_ready.push_back(handle);
+  }
+
+  size_t
+  run() {
+    size_t result(0);
+    while (!m_ready.empty()) {
+      auto handle = m_ready.front();
+      m_ready.pop_front();
+      handle.resume();
+      ++result;
+    }
+    return result;
+  }
+};
+
+using Pool_t = AwaitableBitset<Bitset<1024, uint64_t>>;
+
+Task
+acquire_into(Pool_t &pool, bool set, size_t &out) {
+  out = co_await pool.acquire(set);
+}
+
+Task
+acquire_into(Pool_t &pool, bool set, QueueExecutor &ex, size_t &out) {
+  out = co_await pool.acquire(set, ex);
+}
+
+TEST_F(AwaitableBitsetTest, test_handoff_fifo) {
+  Bitset<1024, uint64_t> bb{false};
+  Pool_t pool(bb);
+  for (size_t i = 0; i < bb.size(); ++i) {
+    size_t idx = pool.npos;
+    acquire_into(pool, true, idx);
+    ASSERT_EQ(i, idx);
+  }
+
+  std::vector<size_t> results(3, pool.npos);
+  for (auto &res : results) {
+    acquire_into(pool, true, res);
+    ASSERT_EQ(pool.npos, res);
+  }
+  ASSERT_EQ(size_t(3), pool.waiting(true));
+
+  ASSERT_TRUE(pool.set(5, false));
+  ASSERT_EQ(size_t(5), results[0]);
+  ASSERT_EQ(pool.npos, results[1]);
+  // the bit was handed off and never freed
+  ASSERT_TRUE(bb.test(5));
+
+  ASSERT_TRUE(pool.set(700, false));
+  ASSERT_TRUE(pool.set(3, false));
+  ASSERT_EQ(size_t(700), results[1]);
+  ASSERT_EQ(size_t(3), results[2]);
+  ASSERT_EQ(size_t(0), pool.waiting(true));
+
+  ASSERT_TRUE(pool.set(3, false));
+  ASSERT_FALSE(bb.test(3));
+}
+
+TEST_F(AwaitableBitsetTest, test_executor) {
+  Bitset<1024, uint64_t> bb{false};
+  Pool_t pool(bb);
+  QueueExecutor ex;
+  size_t idx = pool.npos;
+  acquire_into(pool, false, ex, idx);
+  ASSERT_EQ(size_t(1), pool.waiting(false));
+
+  ASSERT_TRUE(pool.set(42, true));
+  ASSERT_EQ(size_t(0), pool.waiting(false));
+  // resumed on the executor and not inline
+  ASSERT_EQ(pool.npos, idx);
+  ASSERT_EQ(size_t(1), ex.run());
+  ASSERT_EQ(size_t(42), idx);
+  ASSERT_FALSE(bb.test(42));
+}
+
+TEST_F(AwaitableBitsetTest, test_fair) {
+  Bitset<1024, uint64_t> bb{false};
+  Pool_t pool(bb);
+  size_t older = pool.npos;
+  acquire_into(pool, false, older);
+  ASSERT_EQ(size_t(1), pool.waiting(false));
+
+  // a bit freed without a hand-off, as when a release finds the waiters
+  // being drained by another thread
+  ASSERT_TRUE(bb.set(9, true));
+
+  size_t newer = pool.npos;
+  acquire_into(pool, false, newer);
+  ASSERT_EQ(size_t(9), older);
+  ASSERT_EQ(pool.npos, newer);
+  ASSERT_EQ(size_t(1), pool.waiting(false));
+
+  ASSERT_TRUE(pool.set(10, true));
+  ASSERT_EQ(size_t(10), newer);
+}
+
+TEST_F(AwaitableBitsetTest, test_release_free_bit) {
+  Bitset<1024, uint64_t> bb{true};
+  Pool_t pool(bb);
+  size_t idx = pool.npos;
+  acquire_into(pool, true, idx);
+  ASSERT_EQ(size_t(1), pool.waiting(true));
+
+  // freed directly, which the waiter does not notice
+  ASSERT_TRUE(bb.set(5, false));
+  ASSERT_EQ(pool.npos, idx);
+  ASSERT_EQ(size_t(1), pool.waiting(true));
+
+  // releasing a free bit is not a hand-off, the waiter claims it instead
+  ASSERT_FALSE(pool.set(5, false));
+  ASSERT_EQ(size_t(5), idx);
+  ASSERT_TRUE(bb.test(5));
+  ASSERT_EQ(size_t(0), pool.waiting(true));
+  ASSERT_TRUE(bb.all(true));
+}
+
+using Small_t = AwaitableBitset<Bitset<64>>;
+
+Task
+hold_and_release(Small_t &pool, std::vector<std::atomic<int>> &owners,
+                 std::atomic<bool> &failed, std::atomic<size_t> &done) {
+  size_t idx = co_await pool.acquire(true);
+  if (idx >= owners.size() || owners[idx].fetch_add(1) != 0) {
+    failed = true;
+  } else {
+    owners[idx].fetch_sub(1);
+  }
+  pool.set(idx, false);
+  done.fetch_add(1);
+}
+
+TEST_F(AwaitableBitsetTest, test_threaded) {
+  constexpr size_t per_thread(20000);
+  constexpr size_t threads(4);
+  Bitset<64> bb{false};
+  Small_t pool(bb);
+  std::vector<std::atomic<int>> owners(bb.size());
+  std::atomic<bool> failed(false);
+  std::atomic<size_t> done(0);
+
+  // keep most of the pool claimed so coroutines have to wait
+  for (size_t i = 0; i < 62; ++i) {
+    ASSERT_EQ(i, bb.swap_first(true));
+  }
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      for (size_t i = 0; i < per_thread; ++i) {
+        hold_and_release(pool, owners, failed, done);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  ASSERT_EQ(per_thread * threads, done.load());
+  ASSERT_FALSE(failed.load());
+  ASSERT_EQ(size_t(0), pool.waiting(true));
+  ASSERT_EQ(size_t(62), bb.count());
+}
+
+/**
+ * every waiter releases its bit when resumed, which hands it to the next
+ * waiter. the waiters are resumed one after the other and not nested inside
+ * the release of the previous one
+ */
+TEST_F(AwaitableBitsetTest, test_release_chain) {
+  constexpr size_t waiters(200000);
+  Bitset<64> bb{true};
+  Small_t pool(bb);
+  std::vector<std::atomic<int>> owners(bb.size());
+  std::atomic<bool> failed(false);
+  std::atomic<size_t> done(0);
+
+  for (size_t i = 0; i < waiters; ++i) {
+    hold_and_release(pool, owners, failed, done);
+  }
+  ASSERT_EQ(waiters, pool.waiting(true));
+  ASSERT_EQ(size_t(0), done.load());
+
+  ASSERT_TRUE(pool.set(0, false));
+  ASSERT_EQ(waiters, done.load());
+  ASSERT_FALSE(failed.load());
+  ASSERT_EQ(size_t(0), pool.waiting(true));
+  ASSERT_FALSE(bb.test(0));
+}
+#endif
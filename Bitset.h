@@ -1,16 +1,364 @@
 #ifndef SP_CONCURRENT_BITSET_H
 #define SP_CONCURRENT_BITSET_H
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <bitset>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <new>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 namespace sp {
 
-template <size_t T_Size, typename Byte_t = uint8_t>
+/**
+ * Execution policy for the bulk operations of Bitset. The words of the set
+ * are split into chunks of whole cache lines which are processed by
+ * $workers threads, the calling thread included.
+ */
+struct Parallel {
+  size_t workers;
+
+  explicit Parallel(size_t w = std::thread::hardware_concurrency()) noexcept
+      : workers(w == 0 ? 1 : w) {
+  }
+};
+
+#if defined(SP_BITSET_DOUBLE_WORD) && defined(__SIZEOF_INT128__) &&          \
+    defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#define SP_BITSET_DWCAS 1
+
+/**
+ * Minimal std::atomic like double word. All operations are implemented with
+ * the double-width CAS since a 16 byte std::atomic is not lock free in
+ * libstdc++. Available when compiling with double-width CAS support,
+ * -mcx16 on x86-64, and opted into by defining SP_BITSET_DOUBLE_WORD.
+ *
+ * Since a load is also a CAS, every read is a locked write to the cache line
+ * of the word, so concurrent readers contend with each other. This only pays
+ * off for sets which are mostly swapped, read-mostly sets are better off in
+ * the generic storage which is used when it is not opted into.
+ */
+struct AtomicDWord {
+  using Word_t = unsigned __int128;
+
+private:
+  mutable Word_t m_value;
+
+public:
+  explicit AtomicDWord(Word_t v) noexcept //
+      : m_value(v) {
+  }
+
+  Word_t
+  load(std::memory_order = std::memory_order_seq_cst) const noexcept {
+    return __sync_val_compare_and_swap(&m_value, Word_t(0), Word_t(0));
+  }
+
+  bool
+  compare_exchange_strong(Word_t &expected, Word_t desired) noexcept {
+    const Word_t prev =
+        __sync_val_compare_and_swap(&m_value, expected, desired);
+    if (prev == expected) {
+      return true;
+    }
+    expected = prev;
+    return false;
+  }
+
+  void
+  store(Word_t v) noexcept {
+    Word_t current = load();
+    while (!compare_exchange_strong(current, v)) {
+    }
+  }
+
+  Word_t
+  fetch_or(Word_t v) noexcept {
+    Word_t current = load();
+    while (!compare_exchange_strong(current, Word_t(current | v))) {
+    }
+    return current;
+  }
+
+  Word_t
+  fetch_and(Word_t v) noexcept {
+    Word_t current = load();
+    while (!compare_exchange_strong(current, Word_t(current & v))) {
+    }
+    return current;
+  }
+};
+#endif
+
+/**
+ * Leading and trailing zero counts of native and double words, $word is
+ * required to be != 0
+ */
+struct BitScan {
+  template <typename Word_t>
+  static size_t
+  leading(Word_t word) noexcept {
+    constexpr size_t width = sizeof(Word_t) * 8;
+#if defined(__GNUC__)
+    if constexpr (width > 64) {
+      const uint64_t high = uint64_t(word >> 64);
+      if (high != 0) {
+        return size_t(__builtin_clzll(high));
+      }
+      return 64 + size_t(__builtin_clzll(uint64_t(word)));
+    } else {
+      return size_t(__builtin_clzll((unsigned long long)word)) - (64 - width);
+    }
+#else
+    size_t idx(0);
+    while (Word_t(word & Word_t(Word_t(1) << (width - 1 - idx))) == 0) {
+      ++idx;
+    }
+    return idx;
+#endif
+  }
+
+  template <typename Word_t>
+  static size_t
+  trailing(Word_t word) noexcept {
+#if defined(__GNUC__)
+    if constexpr (sizeof(Word_t) * 8 > 64) {
+      const uint64_t low = uint64_t(word);
+      if (low != 0) {
+        return size_t(__builtin_ctzll(low));
+      }
+      return 64 + size_t(__builtin_ctzll(uint64_t(word >> 64)));
+    } else {
+      return size_t(__builtin_ctzll((unsigned long long)word));
+    }
+#else
+    size_t idx(0);
+    while (Word_t(word & Word_t(Word_t(1) << idx)) == 0) {
+      ++idx;
+    }
+    return idx;
+#endif
+  }
+};
+
+/**
+ * Bit order policy of Bitset storing bit 0 of a word in its most
+ * significant bit. This is the default.
+ *
+ * |word|
+ * ^    ^
+ * |bit 0
+ */
+struct MsbFirst {
+  static constexpr bool lsb = false;
+
+  /* the bit $idx of a word */
+  template <typename Word_t>
+  static constexpr Word_t
+  bit(size_t idx) noexcept {
+    return Word_t(Word_t(1) << (sizeof(Word_t) * 8 - 1 - idx));
+  }
+
+  /* the bits [idx, width) of a word */
+  template <typename Word_t>
+  static constexpr Word_t
+  from(size_t idx) noexcept {
+    return idx >= sizeof(Word_t) * 8 ? Word_t(0)
+                                     : Word_t(Word_t(~Word_t(0)) >> idx);
+  }
+
+  /* the index of the first bit of $word, $word is required to be != 0 */
+  template <typename Word_t>
+  static size_t
+  first(Word_t word) noexcept {
+    return BitScan::leading(word);
+  }
+
+  /* the index of the last bit of $word, $word is required to be != 0 */
+  template <typename Word_t>
+  static size_t
+  last(Word_t word) noexcept {
+    return sizeof(Word_t) * 8 - 1 - BitScan::trailing(word);
+  }
+};
+
+/**
+ * Bit order policy of Bitset storing bit 0 of a word in its least
+ * significant bit, the layout used by std::bitset, Arrow validity buffers
+ * and kernel bitmaps. Words of such bitmaps can be copied to and from the
+ * set as they are, and scans use trailing zero counts.
+ *
+ * |word|
+ * ^    ^
+ * |    |bit 0
+ */
+struct LsbFirst {
+  static constexpr bool lsb = true;
+
+  template <typename Word_t>
+  static constexpr Word_t
+  bit(size_t idx) noexcept {
+    return Word_t(Word_t(1) << idx);
+  }
+
+  template <typename Word_t>
+  static constexpr Word_t
+  from(size_t idx) noexcept {
+    return idx >= sizeof(Word_t) * 8 ? Word_t(0)
+                                     : Word_t(Word_t(~Word_t(0)) << idx);
+  }
+
+  template <typename Word_t>
+  static size_t
+  first(Word_t word) noexcept {
+    return BitScan::trailing(word);
+  }
+
+  template <typename Word_t>
+  static size_t
+  last(Word_t word) noexcept {
+    return sizeof(Word_t) * 8 - 1 - BitScan::leading(word);
+  }
+};
+
+template <size_t T_Size, typename Byte_t, typename Dirty, typename Storage,
+          typename Order>
+class Bitset;
+
+/**
+ * Storage policy of Bitset keeping the words inline in the Bitset object.
+ */
+struct InlineStorage {
+  static constexpr bool heap = false;
+  static constexpr bool external = false;
+
+  template <typename T, size_t T_Count>
+  using Array = std::array<T, T_Count>;
+};
+
+/**
+ * Storage policy of Bitset adopting a buffer of words owned by the caller,
+ * the Bitset constructed with Bitset(words) is a view of the buffer and
+ * neither copies nor frees it. The buffer is required to outlive the set and
+ * to contain at least as many words as the set. The words are accessed as
+ * atomics of the same size and alignment.
+ */
+struct ExternalStorage {
+  static constexpr bool heap = false;
+  static constexpr bool external = true;
+
+  template <typename T, size_t T_Count>
+  class Array {
+  private:
+    T *m_data;
+
+  public:
+    template <typename Word_t>
+    explicit Array(Word_t *words) noexcept //
+        : m_data(reinterpret_cast<T *>(words)) {
+      static_assert(sizeof(T) == sizeof(Word_t) &&
+                        alignof(T) == alignof(Word_t),
+                    "Atomic words are required to have the layout of words");
+      static_assert(T::is_always_lock_free,
+                    "Atomic words are required to be lock free");
+    }
+
+    T &operator[](size_t idx) noexcept {
+      return m_data[idx];
+    }
+
+    const T &operator[](size_t idx) const noexcept {
+      return m_data[idx];
+    }
+
+    T *
+    data() noexcept {
+      return m_data;
+    }
+
+    const T *
+    data() const noexcept {
+      return m_data;
+    }
+
+    constexpr size_t
+    size() const noexcept {
+      return T_Count;
+    }
+  };
+};
+
+/**
+ * Dirty tracking policy of Bitset which tracks nothing.
+ */
+struct Untracked {
+  static constexpr bool enabled = false;
+
+  template <size_t T_Words>
+  struct Tracker {
+    void
+    mark(size_t, size_t) noexcept {
+    }
+  };
+};
+
+/**
+ * Dirty tracking policy of Bitset. The words are grouped into blocks of
+ * $T_Block_Words and every mutating operation marks the blocks it changed in
+ * a dirty bitmap, which is drained by Bitset::collect_delta().
+ */
+template <size_t T_Block_Words = 8>
+struct DirtyBlocks {
+  static_assert(T_Block_Words > 0, "Blocks are required to contain words");
+  static constexpr bool enabled = true;
+  static constexpr size_t block_words = T_Block_Words;
+
+  template <size_t T_Words>
+  struct Tracker {
+    static constexpr size_t blocks =
+        (T_Words + T_Block_Words - 1) / T_Block_Words;
+    static constexpr size_t npos = blocks;
+
+  private:
+    Bitset<((blocks + 7) / 8) * 8, uint64_t, Untracked, InlineStorage,
+           MsbFirst>
+        m_blocks;
+
+  public:
+    /* marks the blocks of the words [fromWord, toWord) as dirty */
+    void
+    mark(size_t fromWord, size_t toWord) noexcept {
+      if (fromWord >= toWord) {
+        return;
+      }
+      const size_t last = (toWord - 1) / T_Block_Words;
+      for (size_t block = fromWord / T_Block_Words; block <= last; ++block) {
+        // does not write if the block is allready dirty
+        m_blocks.set(block, true);
+      }
+    }
+
+    /**
+     * clears the first dirty block starting from $block
+     * returns the index of the block or npos if there is none
+     */
+    size_t
+    drain(size_t block) noexcept {
+      const size_t res = m_blocks.swap_first(block, false, blocks);
+      return res < blocks ? res : npos;
+    }
+  };
+};
+
+template <size_t T_Size, typename Byte_t = uint8_t, typename Dirty = Untracked,
+          typename Storage = InlineStorage, typename Order = MsbFirst>
 class Bitset {
 public:
   static constexpr size_t npos = T_Size;
@@ -19,14 +367,62 @@ private:
   using Entry_t = std::atomic<Byte_t>;
   static constexpr size_t bits = sizeof(Byte_t) * 8;
   static constexpr size_t T_Words = size_t(std::ceil(double(T_Size) / bits));
-  static constexpr Byte_t one_ = Byte_t(1) << size_t(bits - 1); // 10000...
-  //
   static_assert(std::is_scalar<Byte_t>::value,
                 "Backing structure is required to be a scalar");
   static_assert(std::is_integral<Byte_t>::value,
                 "Backing structure is required to be a integral");
   static_assert(T_Size % 8 == 0, "Size should be evenly divisable with 8");
 
+  enum class Combine { Union, Intersection, Difference };
+
+  /* the bit $idx of a word in the bit order of the set */
+  template <typename Word_t>
+  static constexpr Word_t
+  bit_mask(size_t idx) noexcept {
+    return Order::template bit<Word_t>(idx);
+  }
+
+  /* the bits [idx, width) of a word in the bit order of the set */
+  template <typename Word_t>
+  static constexpr Word_t
+  bits_from(size_t idx) noexcept {
+    return Order::template from<Word_t>(idx);
+  }
+
+  /* index of the first set bit in $word, $word is required to be != 0 */
+  template <typename Word_t>
+  static size_t
+  first_index(Word_t word) noexcept {
+    return Order::first(word);
+  }
+
+  /* index of the last set bit in $word, $word is required to be != 0 */
+  template <typename Word_t>
+  static size_t
+  last_index(Word_t word) noexcept {
+    return Order::last(word);
+  }
+
+  /**
+   * index of the set bit in $word nearest to $bit, preferring the following
+   * bit on a tie, $word is required to be != 0
+   */
+  template <typename Word_t>
+  static size_t
+  nearest_index(Word_t word, size_t bit) noexcept {
+    const Word_t after = Word_t(word & bits_from<Word_t>(bit));
+    const Word_t before = Word_t(word & Word_t(~bits_from<Word_t>(bit)));
+    if (before == Word_t(0)) {
+      return first_index(after);
+    }
+    if (after == Word_t(0)) {
+      return last_index(before);
+    }
+    const size_t next = first_index(after);
+    const size_t prev = last_index(before);
+    return next - bit <= bit - prev ? next : prev;
+  }
+
   /**
    * |word|word|...|
    * ^         ^
@@ -35,22 +431,32 @@ private:
   struct Entry {
   private:
   public:
-    std::array<Entry_t, T_Words> m_data;
+    using Word_t = Byte_t;
+    static constexpr size_t words = T_Words;
 
-    Entry() noexcept //
-        : m_data() {
+    typename Storage::template Array<Entry_t, T_Words> m_data;
+    typename Dirty::template Tracker<T_Words> m_dirty;
+
+    Entry() noexcept(!Storage::heap) //
+        : m_data()
+        , m_dirty() {
     }
 
-    explicit Entry(const std::bitset<T_Size> &init) noexcept //
+    explicit Entry(const std::bitset<T_Size> &init) noexcept(!Storage::heap) //
         : Entry() {
       transfer(init);
     }
 
-    explicit Entry(bool v) noexcept //
+    explicit Entry(bool v) noexcept(!Storage::heap) //
         : Entry() {
       init_with(v ? ~Byte_t(0) : Byte_t(0));
     }
 
+    explicit Entry(Byte_t *words) noexcept //
+        : m_data(words)
+        , m_dirty() {
+    }
+
   private:
     constexpr size_t
     byte_index(size_t idx) const noexcept {
@@ -90,9 +496,7 @@ private:
       size_t i(0);
       for (; i < init.size(); ++i) {
         if (init[i]) {
-          size_t bitoffset = (bits - 1) - (i % bits);
-          Byte_t cbits = Byte_t(1) << bitoffset;
-          word = word | cbits;
+          word = word | bit_mask<Byte_t>(i % bits);
         }
 
         if (size_t(i + 1) % bits == size_t(0)) {
@@ -116,7 +520,7 @@ private:
       Entry_t &e = word_for(byte_index(bitIdx));
 
       const Byte_t offset = word_index(bitIdx);
-      const Byte_t mask = one_ >> offset;
+      const Byte_t mask = bit_mask<Byte_t>(offset);
 
       auto word_before = e.load();
       Byte_t word;
@@ -141,6 +545,7 @@ private:
          * the current value
          */
       } while (!e.compare_exchange_strong(word_before, word));
+      m_dirty.mark(byte_index(bitIdx), byte_index(bitIdx) + 1);
       return true;
     }
 
@@ -155,7 +560,7 @@ private:
       const Entry_t &e = word_for(byteIdx);
 
       auto wordIdx = word_index(bitIdx);
-      const Byte_t mask = one_ >> wordIdx;
+      const Byte_t mask = bit_mask<Byte_t>(wordIdx);
 
       auto word = e.load();
       return Byte_t(word & mask) != Byte_t(0);
@@ -163,9 +568,7 @@ private:
 
     Byte_t
     mask_right(Byte_t idx) const noexcept {
-      const Byte_t b = ~Byte_t(0);
-      const Byte_t res = b >> idx;
-      return res;
+      return bits_from<Byte_t>(idx);
     }
 
     /* 11111111_11111111|65535
@@ -175,7 +578,8 @@ private:
      * 00000000_00000001|1
      */
     bool
-    all(size_t bitIdx, Byte_t test) const noexcept {
+    all(size_t bitIdx, bool v) const noexcept {
+      const Byte_t test = v ? ~Byte_t(0) : Byte_t(0);
       size_t idx = byte_index(bitIdx);
       Byte_t wordIdx = word_index(bitIdx);
 
@@ -187,7 +591,8 @@ private:
 
         current = current & mask_right(wordIdx);
 
-        if (current != mask) {
+        if (Byte_t(current & valid_mask(idx)) !=
+            Byte_t(mask & valid_mask(idx))) {
           return false;
         }
         mask = test;
@@ -196,89 +601,753 @@ private:
       return true;
     }
 
+    /**
+     * mask of the bits in word $wordIdx which are part of the set, only the
+     * last word can contain bits past T_Size
+     */
+    Byte_t
+    valid_mask(size_t wordIdx) const noexcept {
+      constexpr size_t tail = T_Size % bits;
+      if (tail != 0 && wordIdx == T_Words - 1) {
+        return Byte_t(~mask_right(Byte_t(tail)));
+      }
+      return ~Byte_t(0);
+    }
+
+    /**
+     * the number of set bits in the words [fromWord, toWord)
+     */
     size_t
-    bit_index(size_t byteIdx, Byte_t wordIdx) const noexcept {
-      return size_t(byteIdx * bits) + wordIdx;
+    count(size_t fromWord, size_t toWord) const noexcept {
+      size_t result(0);
+      for (size_t idx = fromWord; idx < toWord; ++idx) {
+        const Byte_t word = Byte_t(word_for(idx).load() & valid_mask(idx));
+        result += std::bitset<bits>(word).count();
+      }
+      return result;
+    }
+
+    /**
+     * mask of the bits [beginIdx, endIdx) in word $wordIdx, only the first
+     * and the last word of a range are partial
+     */
+    Byte_t
+    range_mask(size_t wordIdx, size_t beginIdx, size_t endIdx) const noexcept {
+      const size_t start = wordIdx * bits;
+      Byte_t mask = ~Byte_t(0);
+      if (beginIdx > start) {
+        mask = Byte_t(mask & mask_right(Byte_t(beginIdx - start)));
+      }
+      if (endIdx < start + bits) {
+        mask = Byte_t(mask & Byte_t(~mask_right(Byte_t(endIdx - start))));
+      }
+      return mask;
+    }
+
+    /**
+     * whether any bit in [beginIdx, endIdx) is $v, stopping at the first word
+     * containing one
+     */
+    bool
+    any(size_t beginIdx, size_t endIdx, bool v) const noexcept {
+      const size_t last = byte_index(endIdx - 1);
+      for (size_t idx = byte_index(beginIdx); idx <= last; ++idx) {
+        const Byte_t word = word_for(idx).load();
+        const Byte_t found = v ? word : Byte_t(~word);
+        if (Byte_t(found & range_mask(idx, beginIdx, endIdx)) != Byte_t(0)) {
+          return true;
+        }
+      }
+      return false;
     }
 
+    /**
+     * the number of set bits in [beginIdx, endIdx)
+     */
     size_t
-    find_first(size_t bitIdx, bool find) const noexcept {
-      // TODO
-      size_t byteIdx = byte_index(bitIdx);
-      auto wordIdx = word_index(bitIdx);
+    count_bits(size_t beginIdx, size_t endIdx) const noexcept {
+      size_t result(0);
+      const size_t last = byte_index(endIdx - 1);
+      for (size_t idx = byte_index(beginIdx); idx <= last; ++idx) {
+        const Byte_t word =
+            Byte_t(word_for(idx).load() & range_mask(idx, beginIdx, endIdx));
+        result += std::bitset<bits>(word).count();
+      }
+      return result;
+    }
 
-      const Byte_t mask = find ? Byte_t(0) : ~Byte_t(0);
+    void
+    fill(size_t fromWord, size_t toWord, bool v) noexcept {
+      const Byte_t def = v ? ~Byte_t(0) : Byte_t(0);
+      for (size_t idx = fromWord; idx < toWord; ++idx) {
+        store(idx, def);
+      }
+      m_dirty.mark(fromWord, toWord);
+    }
 
-      for (; byteIdx < T_Words; ++byteIdx) {
-        auto &wrd = word_for(byteIdx);
-        const Byte_t &word = wrd.load();
+    /**
+     * combines each word in [fromWord, toWord) with the corresponding word
+     * of $o
+     */
+    void
+    combine(const Entry &o, size_t fromWord, size_t toWord,
+            Combine op) noexcept {
+      for (size_t idx = fromWord; idx < toWord; ++idx) {
+        auto &word = word_for(idx);
+        const Byte_t other = o.word_for(idx).load();
+        switch (op) {
+        case Combine::Union:
+          word.fetch_or(other);
+          break;
+        case Combine::Intersection:
+          word.fetch_and(other);
+          break;
+        case Combine::Difference:
+          word.fetch_and(Byte_t(~other));
+          break;
+        }
+      }
+      m_dirty.mark(fromWord, toWord);
+    }
 
-        if (mask != word) {
-          for (size_t bit = wordIdx; bit < bits; ++bit) {
+    /**
+     * drains the dirty blocks and appends their index and words to $out. a
+     * block is cleared before its words are read, so a concurrent change is
+     * either part of this delta or marks the block dirty again.
+     * writers change a word and then check its dirty bit while we clear the
+     * bit and then read the word, which is only ordered when all four are
+     * seq_cst, an acquire load could read the old word while the writer
+     * still sees the bit dirty
+     */
+    template <typename Delta>
+    void
+    collect(Delta &out) {
+      for (size_t block = m_dirty.drain(0); block < m_dirty.npos;
+           block = m_dirty.drain(block + 1)) {
+        out.blocks.push_back(block);
+        const size_t from = block * Dirty::block_words;
+        const size_t to = std::min(from + Dirty::block_words, T_Words);
+        for (size_t idx = from; idx < to; ++idx) {
+          out.words.push_back(word_for(idx).load());
+        }
+      }
+    }
 
-            Byte_t vmask = one_ >> bit;
-            Byte_t cmp = find ? vmask : Byte_t(0); // TODO
+    template <typename Delta>
+    void
+    apply(const Delta &delta) noexcept {
+      size_t wordIdx(0);
+      for (size_t block : delta.blocks) {
+        const size_t from = block * Dirty::block_words;
+        const size_t to = std::min(from + Dirty::block_words, T_Words);
+        for (size_t idx = from; idx < to; ++idx) {
+          // seq_cst for the same reason as in collect()
+          word_for(idx).store(delta.words[wordIdx++]);
+        }
+        m_dirty.mark(from, to);
+      }
+    }
 
-            if (Byte_t(vmask & word) == cmp) {
-              return bit_index(byteIdx, bit);
-            }
-          }
+    /**
+     * copies $count words from $words, which are in the bit order of the
+     * set, into the first words of the set
+     */
+    void
+    assign_words(const Byte_t *words, size_t count) noexcept {
+      static_assert(sizeof(Entry_t) == sizeof(Byte_t) &&
+                        Entry_t::is_always_lock_free,
+                    "Atomic words are required to have the layout of words");
+      std::memcpy(static_cast<void *>(&word_for(0)), words,
+                  count * sizeof(Byte_t));
+      m_dirty.mark(0, count);
+    }
+
+    /* copies the first $count words of the set to $out */
+    void
+    copy_words(Byte_t *out, size_t count) const noexcept {
+      static_assert(sizeof(Entry_t) == sizeof(Byte_t) &&
+                        Entry_t::is_always_lock_free,
+                    "Atomic words are required to have the layout of words");
+      std::memcpy(out, static_cast<const void *>(&word_for(0)),
+                  count * sizeof(Byte_t));
+    }
+
+    size_t
+    bit_index(size_t byteIdx, Byte_t wordIdx) const noexcept {
+      return size_t(byteIdx * bits) + wordIdx;
+    }
+
+    size_t
+    find_first(size_t bitIdx, bool find,
+               size_t limitWord = T_Words) const noexcept {
+      size_t byteIdx = byte_index(bitIdx);
+      Byte_t window = mask_right(word_index(bitIdx));
+
+      for (; byteIdx < limitWord; ++byteIdx) {
+        const Byte_t word = word_for(byteIdx).load();
+        const Byte_t found = Byte_t((find ? word : Byte_t(~word)) & window &
+                                    valid_mask(byteIdx));
+        if (found != Byte_t(0)) {
+          return bit_index(byteIdx, first_index(found));
         }
-        wordIdx = Byte_t(0);
+        window = ~Byte_t(0);
       }
       return npos;
     }
 
     size_t
     swap_first(size_t bitIdx, bool set, size_t limitIdx) noexcept {
-      size_t wordIdx = byte_index(bitIdx);
-      Byte_t wordBitStart = word_index(bitIdx);
-      /**
-       * we only need to look in words which is not:
-       * all 1 if 'set' is true
-       * all 0 if 'set' is false
-       */
-      const Byte_t mask = set ? ~Byte_t(0) : Byte_t(0);
-
-      const size_t limitWord = byte_index(limitIdx);
-      while (wordIdx <= limitWord) {
+      if (limitIdx > T_Size) {
+        limitIdx = T_Size;
+      }
+      if (bitIdx >= limitIdx) {
+        return T_Size;
+      }
+      const size_t limitWord = byte_index(limitIdx - 1);
+      for (size_t wordIdx = byte_index(bitIdx); wordIdx <= limitWord;
+           ++wordIdx) {
         auto &current = word_for(wordIdx);
+        const Byte_t window = range_mask(wordIdx, bitIdx, limitIdx);
         Byte_t word = current.load(std::memory_order_acquire);
+        /**
+         * we only need to look at the bits which are:
+         * 0 if 'set' is true
+         * 1 if 'set' is false
+         */
+        while (true) {
+          const Byte_t found = Byte_t((set ? Byte_t(~word) : word) & window);
+          if (found == Byte_t(0)) {
+            break;
+          }
+          const size_t bit = first_index(found);
+          const Byte_t vmask = bit_mask<Byte_t>(bit);
+          const Byte_t value = set ? Byte_t(word | vmask)
+                                   : Byte_t(word & Byte_t(vmask ^ ~Byte_t(0)));
+          /**
+           * if the compare exchange fails $word is updated with the current
+           * value and we look for another bit in the same word
+           */
+          if (current.compare_exchange_strong(word, value)) {
+            m_dirty.mark(wordIdx, wordIdx + 1);
+            return bit_index(wordIdx, bit);
+          }
+        }
+      }
+      return T_Size;
+    }
 
-        if (mask != word) {
-          size_t bitMax = wordIdx == limitWord ? word_index(limitIdx) : bits;
-          for (size_t bit = wordBitStart; bit < bitMax; ++bit) {
-            /**
-             * Mask for current bit: 0001000
-             */
-            const Byte_t vmask = one_ >> bit;
-            const Byte_t cmp = set ? Byte_t(0) : vmask;
-
-            if (Byte_t(vmask & word) == cmp) {
-              Byte_t value = set ? Byte_t(word | vmask)
-                                 : Byte_t(word & Byte_t(vmask ^ ~Byte_t(0)));
-              if (current.compare_exchange_strong(word, value)) {
-                return bit_index(wordIdx, bit);
-              }
-            }
-          } // for
+    /**
+     * swaps up to $max bits in the first word containing any bit which is
+     * not $set, with a single CAS. the indices of the swapped bits are written
+     * to $out.
+     * returns the number of bits swapped, 0 if no bit could be swapped
+     */
+    size_t
+    swap_batch(size_t bitIdx, bool set, size_t limitIdx, size_t *out,
+               size_t max) noexcept {
+      if (limitIdx > T_Size) {
+        limitIdx = T_Size;
+      }
+      if (bitIdx >= limitIdx) {
+        return 0;
+      }
+      const size_t limitWord = byte_index(limitIdx - 1);
+      for (size_t wordIdx = byte_index(bitIdx); wordIdx <= limitWord;
+           ++wordIdx) {
+        auto &current = word_for(wordIdx);
+        const Byte_t window = range_mask(wordIdx, bitIdx, limitIdx);
+        Byte_t word = current.load(std::memory_order_acquire);
+
+        while (true) {
+          Byte_t found = Byte_t((set ? Byte_t(~word) : word) & window);
+          if (found == Byte_t(0)) {
+            break;
+          }
+          size_t cnt(0);
+          Byte_t take(0);
+          for (; cnt < max && found != Byte_t(0); ++cnt) {
+            const size_t bit = first_index(found);
+            const Byte_t vmask = bit_mask<Byte_t>(bit);
+            take = Byte_t(take | vmask);
+            found = Byte_t(found & Byte_t(vmask ^ ~Byte_t(0)));
+            out[cnt] = bit_index(wordIdx, bit);
+          }
+          const Byte_t value = set ? Byte_t(word | take)
+                                   : Byte_t(word & Byte_t(take ^ ~Byte_t(0)));
+          /**
+           * if the compare exchange fails $word is updated with the current
+           * value and we retry on the same word
+           */
+          if (current.compare_exchange_strong(word, value)) {
+            m_dirty.mark(wordIdx, wordIdx + 1);
+            return cnt;
+          }
+        }
+      }
+      return 0;
+    }
+
+    /**
+     * swaps the bit in [lowIdx, highIdx) nearest to $hintIdx which is not
+     * $set. the words are searched outward from the word of $hintIdx, first
+     * within its cache line, then within its page and last in the whole set,
+     * so that a bit sharing a line or a page with the hint is preferred over
+     * a closer one which does not. the lines and pages are taken from the
+     * addresses of the words, so they hold however the words are aligned.
+     * pages are regular 4KB pages, huge pages are not considered.
+     * returns T_Size if there is no such bit
+     */
+    size_t
+    swap_near(size_t hintIdx, bool set, size_t lowIdx,
+              size_t highIdx) noexcept {
+      // 0 is the whole set
+      const size_t levels[] = {cache_line, page_size, 0};
+
+      const size_t hint = byte_index(hintIdx);
+      const size_t low = byte_index(lowIdx);
+      const size_t high = byte_index(highIdx - 1) + 1;
+      const uintptr_t address = reinterpret_cast<uintptr_t>(&word_for(hint));
+      // the words searched so far are [down, up)
+      size_t down = hint;
+      size_t up = hint;
+      for (size_t level : levels) {
+        size_t from = low;
+        size_t to = high;
+        if (level != 0) {
+          // the words of the line or page which contains the hint word
+          const size_t before = (address & (level - 1)) / sizeof(Entry_t);
+          const size_t after = level / sizeof(Entry_t) - before;
+          from = std::max(low, hint - std::min(hint, before));
+          to = std::min(high, hint + after);
+        }
+
+        while (up < to || down > from) {
+          size_t wordIdx;
+          if (down == from || (up < to && up - hint <= hint - (down - 1))) {
+            wordIdx = up++;
+          } else {
+            wordIdx = --down;
+          }
+          const size_t res = swap_in(wordIdx, hintIdx, set, lowIdx, highIdx);
+          if (res != T_Size) {
+            return res;
+          }
         }
-        wordBitStart = Byte_t(0);
-        ++wordIdx;
-      } // while
+      }
       return T_Size;
     }
+
+  private:
+    /**
+     * swaps the bit of word $wordIdx in [lowIdx, highIdx) nearest to $hintIdx
+     * which is not $set
+     */
+    size_t
+    swap_in(size_t wordIdx, size_t hintIdx, bool set, size_t lowIdx,
+            size_t highIdx) noexcept {
+      auto &current = word_for(wordIdx);
+      const Byte_t window = range_mask(wordIdx, lowIdx, highIdx);
+      const size_t hint = byte_index(hintIdx);
+      Byte_t word = current.load(std::memory_order_acquire);
+      while (true) {
+        const Byte_t found = Byte_t((set ? Byte_t(~word) : word) & window);
+        if (found == Byte_t(0)) {
+          return T_Size;
+        }
+
+        size_t bit;
+        if (wordIdx == hint) {
+          bit = nearest_index(found, word_index(hintIdx));
+        } else if (wordIdx > hint) {
+          bit = first_index(found);
+        } else {
+          bit = last_index(found);
+        }
+        const Byte_t vmask = bit_mask<Byte_t>(bit);
+        const Byte_t value = set ? Byte_t(word | vmask)
+                                 : Byte_t(word & Byte_t(vmask ^ ~Byte_t(0)));
+        /**
+         * if the compare exchange fails $word is updated with the current
+         * value and we look for another bit in the same word
+         */
+        if (current.compare_exchange_strong(word, value)) {
+          m_dirty.mark(wordIdx, wordIdx + 1);
+          return bit_index(wordIdx, bit);
+        }
+      }
+    }
+  };
+
+
+  /**
+   * Storage for sets which fit in a single native word, or in a double word
+   * where double-width CAS is opted into. Every operation is a load followed
+   * by at most one RMW, the scans are replaced with leading or trailing zero
+   * counts on the whole word, depending on the bit order. Loads of a double
+   * word are RMWs as well, see AtomicDWord.
+   *
+   * |word|
+   * ^    ^
+   * |bit 0, with MsbFirst
+   */
+  template <typename Word, typename Atomic>
+  struct WordEntry {
+    using Word_t = Word;
+    static constexpr size_t words = 1;
+
+  private:
+    static constexpr size_t width = sizeof(Word_t) * 8;
+    static constexpr Word_t all_ = Word_t(~Word_t(0));
+    // the bits which are part of the set
+    static constexpr Word_t valid_ =
+        T_Size == width ? all_
+                        : Word_t(~Order::template from<Word_t>(T_Size));
+
+    static_assert(T_Size <= width, "Set does not fit in a single word");
+
+  public:
+    Atomic m_word;
+
+    WordEntry() noexcept //
+        : m_word(Word_t(0)) {
+    }
+
+    explicit WordEntry(const std::bitset<T_Size> &init) noexcept //
+        : WordEntry() {
+      Word_t word(0);
+      for (size_t i = 0; i < T_Size; ++i) {
+        if (init[i]) {
+          word = Word_t(word | bit_mask<Word_t>(i));
+        }
+      }
+      m_word.store(word);
+    }
+
+    explicit WordEntry(bool v) noexcept //
+        : m_word(v ? all_ : Word_t(0)) {
+    }
+
+  private:
+    /* the bits [bitIdx, width) */
+    static constexpr Word_t
+    mask_from(size_t bitIdx) noexcept {
+      return bits_from<Word_t>(bitIdx);
+    }
+
+    /* the bits [fromIdx, toIdx) */
+    static constexpr Word_t
+    span(size_t fromIdx, size_t toIdx) noexcept {
+      return Word_t(mask_from(fromIdx) & Word_t(~mask_from(toIdx)));
+    }
+
+    static size_t
+    first(Word_t word) noexcept {
+      return first_index(word);
+    }
+
+    /* the offset of the set word $wordIdx in the word */
+    static constexpr size_t
+    shift(size_t wordIdx) noexcept {
+      return Order::lsb ? wordIdx * bits : width - (wordIdx + 1) * bits;
+    }
+
+    static size_t
+    popcount(Word_t word) noexcept {
+      if constexpr (width > 64) {
+        return std::bitset<64>(uint64_t(word >> 64)).count() +
+               std::bitset<64>(uint64_t(word)).count();
+      } else {
+        return std::bitset<64>((unsigned long long)word).count();
+      }
+    }
+
+    /**
+     * sets the bits of $mask to $set with a single RMW
+     * returns the previous word
+     */
+    Word_t
+    assign(Word_t mask, bool set) noexcept {
+      return set ? m_word.fetch_or(mask) : m_word.fetch_and(Word_t(~mask));
+    }
+
+    /* the bits of $word which are not $set */
+    static constexpr Word_t
+    candidates(Word_t word, bool set) noexcept {
+      return set ? Word_t(~word) : word;
+    }
+
+  public:
+    bool
+    set(size_t bitIdx, bool b) noexcept {
+      const Word_t mask = bit_mask<Word_t>(bitIdx);
+      const Word_t before = assign(mask, b);
+      return bool(before & mask) != b;
+    }
+
+    bool
+    test(size_t bitIdx) const noexcept {
+      return Word_t(m_word.load() & bit_mask<Word_t>(bitIdx)) != Word_t(0);
+    }
+
+    bool
+    all(size_t bitIdx, bool v) const noexcept {
+      const Word_t mask = span(bitIdx, T_Size);
+      return Word_t(m_word.load() & mask) == (v ? mask : Word_t(0));
+    }
+
+    size_t
+    find_first(size_t bitIdx, bool find,
+               size_t limitWord = words) const noexcept {
+      const Word_t word = m_word.load();
+      const Word_t found =
+          Word_t(candidates(word, !find) & span(bitIdx, T_Size));
+      if (limitWord == 0 || found == Word_t(0)) {
+        return T_Size;
+      }
+      return first(found);
+    }
+
+    size_t
+    swap_first(size_t bitIdx, bool set, size_t limitIdx) noexcept {
+      const Word_t window =
+          span(bitIdx, limitIdx < T_Size ? limitIdx : T_Size);
+      Word_t word = m_word.load(std::memory_order_acquire);
+      while (true) {
+        const Word_t found = Word_t(candidates(word, set) & window);
+        if (found == Word_t(0)) {
+          return T_Size;
+        }
+        const size_t bit = first(found);
+        const Word_t mask = bit_mask<Word_t>(bit);
+        /**
+         * the RMW is harmless if we loose the race for the bit, since it
+         * allready has the value we are setting it to
+         */
+        const Word_t before = assign(mask, set);
+        if (bool(before & mask) != set) {
+          return bit;
+        }
+        word = set ? Word_t(before | mask) : Word_t(before & Word_t(~mask));
+      }
+    }
+
+    size_t
+    swap_batch(size_t bitIdx, bool set, size_t limitIdx, size_t *out,
+               size_t max) noexcept {
+      const Word_t window =
+          span(bitIdx, limitIdx < T_Size ? limitIdx : T_Size);
+      Word_t word = m_word.load(std::memory_order_acquire);
+      while (true) {
+        Word_t found = Word_t(candidates(word, set) & window);
+        if (found == Word_t(0)) {
+          return 0;
+        }
+
+        Word_t take(0);
+        for (size_t n = 0; n < max && found != Word_t(0); ++n) {
+          const Word_t mask = bit_mask<Word_t>(first(found));
+          take = Word_t(take | mask);
+          found = Word_t(found & Word_t(~mask));
+        }
+
+        const Word_t before = assign(take, set);
+        Word_t claimed = Word_t(candidates(before, set) & take);
+        size_t cnt(0);
+        while (claimed != Word_t(0)) {
+          const size_t bit = first(claimed);
+          claimed = Word_t(claimed & Word_t(~bit_mask<Word_t>(bit)));
+          out[cnt++] = bit;
+        }
+        if (cnt > 0) {
+          return cnt;
+        }
+        word = set ? Word_t(before | take) : Word_t(before & Word_t(~take));
+      }
+    }
+
+    size_t
+    swap_near(size_t hintIdx, bool set, size_t lowIdx,
+              size_t highIdx) noexcept {
+      const Word_t window = span(lowIdx, highIdx);
+      Word_t word = m_word.load(std::memory_order_acquire);
+      while (true) {
+        const Word_t found = Word_t(candidates(word, set) & window);
+        if (found == Word_t(0)) {
+          return T_Size;
+        }
+        const size_t bit = nearest_index(found, hintIdx);
+        const Word_t mask = bit_mask<Word_t>(bit);
+        const Word_t before = assign(mask, set);
+        if (bool(before & mask) != set) {
+          return bit;
+        }
+        word = set ? Word_t(before | mask) : Word_t(before & Word_t(~mask));
+      }
+    }
+
+    /**
+     * the word is made up of the words of the set in their bit order, so the
+     * first word of the set is the most significant part with MsbFirst and
+     * the least significant part with LsbFirst
+     */
+    void
+    assign_words(const Byte_t *words, size_t count) noexcept {
+      Word_t word(0);
+      Word_t assigned(0);
+      for (size_t idx = 0; idx < count; ++idx) {
+        word = Word_t(word | Word_t(Word_t(words[idx]) << shift(idx)));
+        const Word_t ones = Word_t(Byte_t(~Byte_t(0)));
+        assigned = Word_t(assigned | Word_t(ones << shift(idx)));
+      }
+      m_word.store(
+          Word_t(Word_t(m_word.load() & Word_t(~assigned)) | word));
+    }
+
+    void
+    copy_words(Byte_t *out, size_t count) const noexcept {
+      const Word_t word = m_word.load();
+      for (size_t idx = 0; idx < count; ++idx) {
+        out[idx] = Byte_t(word >> shift(idx));
+      }
+    }
+
+    size_t
+    count(size_t fromWord, size_t toWord) const noexcept {
+      if (fromWord >= toWord) {
+        return 0;
+      }
+      return popcount(Word_t(m_word.load() & valid_));
+    }
+
+    bool
+    any(size_t beginIdx, size_t endIdx, bool v) const noexcept {
+      const Word_t word = m_word.load();
+      return Word_t(candidates(word, !v) & span(beginIdx, endIdx)) != Word_t(0);
+    }
+
+    size_t
+    count_bits(size_t beginIdx, size_t endIdx) const noexcept {
+      return popcount(Word_t(m_word.load() & span(beginIdx, endIdx)));
+    }
+
+    void
+    fill(size_t fromWord, size_t toWord, bool v) noexcept {
+      if (fromWord < toWord) {
+        m_word.store(v ? all_ : Word_t(0));
+      }
+    }
+
+    void
+    combine(const WordEntry &o, size_t fromWord, size_t toWord,
+            Combine op) noexcept {
+      if (fromWord >= toWord) {
+        return;
+      }
+      const Word_t other = o.m_word.load();
+      switch (op) {
+      case Combine::Union:
+        m_word.fetch_or(other);
+        break;
+      case Combine::Intersection:
+        m_word.fetch_and(other);
+        break;
+      case Combine::Difference:
+        m_word.fetch_and(Word_t(~other));
+        break;
+      }
+    }
   };
 
+  /* the smallest native word which fits the set */
+  using Small_t = std::conditional_t<
+      (bits >= T_Size), Byte_t,
+      std::conditional_t<
+          (T_Size <= 16), uint16_t,
+          std::conditional_t<(T_Size <= 32), uint32_t, uint64_t>>>;
+
+#if defined(SP_BITSET_DWCAS)
+  using Wide_t = std::conditional_t<(T_Size <= 128),
+                                    WordEntry<AtomicDWord::Word_t, AtomicDWord>,
+                                    Entry>;
+#else
+  using Wide_t = Entry;
+#endif
+
+  /**
+   * dirty tracking, heap and external storage are only implemented by the
+   * generic storage
+   */
+  using Impl_t = std::conditional_t<
+      Dirty::enabled || Storage::heap || Storage::external, Entry,
+      std::conditional_t<(T_Size <= 64),
+                         WordEntry<Small_t, std::atomic<Small_t>>, Wide_t>>;
+
 private:
-  Entry m_entry;
+  Impl_t m_entry;
+
+  static constexpr size_t word_bits = sizeof(typename Impl_t::Word_t) * 8;
+  static constexpr size_t cache_line = 64;
+  static constexpr size_t page_size = 4096;
+  static constexpr size_t line_words =
+      sizeof(typename Impl_t::Word_t) >= cache_line
+          ? 1
+          : cache_line / sizeof(typename Impl_t::Word_t);
+
+  /**
+   * the number of words in each chunk when split between $p.workers, always
+   * a multiple of a cache line worth of words
+   */
+  static size_t
+  chunk_words(const Parallel &p) noexcept {
+    const size_t lines = (Impl_t::words + line_words - 1) / line_words;
+    const size_t workers = p.workers < lines ? p.workers : lines;
+    return ((lines + workers - 1) / workers) * line_words;
+  }
+
+  static size_t
+  chunks(const Parallel &p) noexcept {
+    const size_t per = chunk_words(p);
+    return (Impl_t::words + per - 1) / per;
+  }
+
+  /**
+   * runs $f(chunk, fromWord, toWord) for each chunk concurrently, the last
+   * chunk is run on the calling thread. if a thread can not be started the
+   * chunks not yet started are run on the calling thread as well
+   */
+  template <typename F>
+  static void
+  for_each_chunk(const Parallel &p, F f) {
+    const size_t per = chunk_words(p);
+    const size_t cnt = chunks(p);
+
+    std::vector<std::thread> workers;
+    size_t c(0);
+    try {
+      workers.reserve(cnt);
+      for (; c + 1 < cnt; ++c) {
+        workers.emplace_back(f, c, c * per, (c + 1) * per);
+      }
+    } catch (const std::system_error &) {
+    } catch (const std::bad_alloc &) {
+    }
+    for (; c < cnt; ++c) {
+      f(c, c * per, std::min((c + 1) * per, Impl_t::words));
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
 
 public:
-  explicit Bitset(const std::bitset<T_Size> &init) noexcept //
+  /**
+   *  @throw  std::bad_alloc  if heap storage could not be allocated
+   */
+  explicit Bitset(const std::bitset<T_Size> &init) noexcept(!Storage::heap) //
       : m_entry{init} {
   }
 
-  Bitset() noexcept //
+  Bitset() noexcept(!Storage::heap) //
       : m_entry{} {
   }
 
@@ -286,10 +1355,22 @@ public:
    *  @brief init the bitset with
    *  @param  b  the value to fill with
    */
-  explicit Bitset(bool v) noexcept //
+  explicit Bitset(bool v) noexcept(!Storage::heap) //
       : m_entry(v) {
   }
 
+  /**
+   *  @brief a view of the caller owned $words, which are used in place
+   *         without being copied or initialised. requires ExternalStorage
+   *  @param  words  at least words() words in the bit order of the set
+   */
+  template <typename Word_t,
+            typename = std::enable_if_t<std::is_same<Word_t, Byte_t>::value>>
+  explicit Bitset(Word_t *words) noexcept //
+      : m_entry(words) {
+    static_assert(Storage::external, "Bitset is required to be a view");
+  }
+
   Bitset(const Bitset &) = delete;
   Bitset(Bitset &&) = delete;
 
@@ -306,6 +1387,38 @@ public:
     return T_Size;
   }
 
+  /* the number of Byte_t words making up the set */
+  static constexpr size_t
+  words() noexcept {
+    return T_Words;
+  }
+
+  /**
+   *  @brief copies $count words from $words into the first words of the set.
+   *         the words are required to be in the bit order of the set, with
+   *         LsbFirst bitmaps in the layout of std::bitset or Arrow are copied
+   *         as they are. not atomic with respect to other operations
+   *  @return the number of words copied
+   */
+  size_t
+  assign_words(const Byte_t *words, size_t count) noexcept {
+    count = std::min(count, T_Words);
+    m_entry.assign_words(words, count);
+    return count;
+  }
+
+  /**
+   *  @brief copies the first $count words of the set to $out, in the bit
+   *         order of the set. not atomic with respect to other operations
+   *  @return the number of words copied
+   */
+  size_t
+  copy_words(Byte_t *out, size_t count) const noexcept {
+    count = std::min(count, T_Words);
+    m_entry.copy_words(out, count);
+    return count;
+  }
+
   /**
    *  @brief sets the specified bit to b
    *  @param  bitIdx  The index of a bit.
@@ -342,7 +1455,7 @@ public:
     if (bitIdx >= T_Size) {
       return false;
     }
-    return m_entry.all(bitIdx, test ? ~Byte_t(0) : Byte_t(0));
+    return m_entry.all(bitIdx, test);
   }
 
   bool
@@ -386,6 +1499,239 @@ public:
     return swap_first(size_t(0), set, limit);
   }
 
+  /**
+   *  @brief swaps the bit nearest to $hint which is not $set, to keep related
+   *         bits on the same cache lines and pages. the search goes outward
+   *         in both directions from the word of $hint, first within its cache
+   *         line, then its page, then the whole set
+   *  @param  hint  index to search around, e.g. the bit last used by the
+   *                same owner
+   *  @param  radius  only bits within $radius of $hint are considered
+   *  @return the index of the swapped bit or npos
+   */
+  size_t
+  swap_first_near(size_t hint, bool set, size_t radius = T_Size) noexcept {
+    if (hint >= T_Size) {
+      return npos;
+    }
+    const size_t low = hint > radius ? hint - radius : 0;
+    const size_t high = T_Size - hint > radius ? hint + radius + 1 : T_Size;
+    return m_entry.swap_near(hint, set, low, high);
+  }
+
+  /**
+   *  @brief swaps a batch of bits to $set using a single CAS
+   *  @param  idx  index to start searching from
+   *  @param  out  receives the indices of the swapped bits
+   *  @param  max  maximum number of bits to swap, capacity of $out
+   *  @return the number of swapped bits, at most the bits of one word
+   */
+  size_t
+  swap_batch(size_t idx, bool set, size_t limit, size_t *out,
+             size_t max) noexcept {
+    if (idx >= T_Size || max == 0) {
+      return 0;
+    }
+    return m_entry.swap_batch(idx, set, limit, out, max);
+  }
+
+  size_t
+  swap_batch(size_t idx, bool set, size_t *out, size_t max) noexcept {
+    return swap_batch(idx, set, T_Size, out, max);
+  }
+
+  size_t
+  swap_batch(bool set, size_t *out, size_t max) noexcept {
+    return swap_batch(size_t(0), set, out, max);
+  }
+
+  /**
+   *  @brief sets all bits to $v
+   */
+  void
+  fill(bool v) noexcept {
+    m_entry.fill(0, Impl_t::words, v);
+  }
+
+  void
+  fill(const Parallel &p, bool v) {
+    for_each_chunk(p, [this, v](size_t, size_t from, size_t to) {
+      m_entry.fill(from, to, v);
+    });
+  }
+
+  /**
+   *  @return the number of set bits
+   */
+  size_t
+  count() const noexcept {
+    return m_entry.count(0, Impl_t::words);
+  }
+
+  /**
+   *  @return the number of set bits in [begin, end)
+   */
+  size_t
+  count(size_t begin, size_t end) const noexcept {
+    if (end > T_Size) {
+      end = T_Size;
+    }
+    if (begin >= end) {
+      return 0;
+    }
+    return m_entry.count_bits(begin, end);
+  }
+
+  /**
+   *  @return true if any bit in [begin, end) is $v
+   */
+  bool
+  any(size_t begin, size_t end, bool v) const noexcept {
+    if (end > T_Size) {
+      end = T_Size;
+    }
+    if (begin >= end) {
+      return false;
+    }
+    return m_entry.any(begin, end, v);
+  }
+
+  /**
+   *  @return true if no bit in [begin, end) is $v
+   */
+  bool
+  none(size_t begin, size_t end, bool v) const noexcept {
+    return !any(begin, end, v);
+  }
+
+  /**
+   *  @return true if all bits in [begin, end) are $v, also for an empty range
+   */
+  bool
+  all(size_t begin, size_t end, bool v) const noexcept {
+    return !any(begin, end, !v);
+  }
+
+  size_t
+  count(const Parallel &p) const {
+    std::vector<size_t> partial(chunks(p), 0);
+    for_each_chunk(p, [this, &partial](size_t c, size_t from, size_t to) {
+      partial[c] = m_entry.count(from, to);
+    });
+
+    size_t result(0);
+    for (size_t cnt : partial) {
+      result += cnt;
+    }
+    return result;
+  }
+
+  /**
+   * parallel reduction returning the lowest index equal to $find, chunks
+   * which starts after an allready found index are abandoned
+   */
+  size_t
+  find_first(const Parallel &p, bool find) const {
+    std::atomic<size_t> best(npos);
+    for_each_chunk(p, [this, find, &best](size_t, size_t from, size_t to) {
+      constexpr size_t step = line_words * 64;
+      for (; from < to; from += step) {
+        if (best.load(std::memory_order_relaxed) < from * word_bits) {
+          return;
+        }
+        const size_t limit = to - from < step ? to : from + step;
+        const size_t res = m_entry.find_first(from * word_bits, find, limit);
+        if (res < npos) {
+          size_t current = best.load();
+          while (res < current && !best.compare_exchange_weak(current, res)) {
+          }
+          return;
+        }
+      }
+    });
+    return best.load();
+  }
+
+  /**
+   *  @brief this = this | o
+   */
+  void
+  set_union(const Bitset &o) noexcept {
+    m_entry.combine(o.m_entry, 0, Impl_t::words, Combine::Union);
+  }
+
+  void
+  set_union(const Parallel &p, const Bitset &o) {
+    combine(p, o, Combine::Union);
+  }
+
+  /**
+   *  @brief this = this & o
+   */
+  void
+  set_intersection(const Bitset &o) noexcept {
+    m_entry.combine(o.m_entry, 0, Impl_t::words, Combine::Intersection);
+  }
+
+  void
+  set_intersection(const Parallel &p, const Bitset &o) {
+    combine(p, o, Combine::Intersection);
+  }
+
+  /**
+   *  @brief this = this & ~o
+   */
+  void
+  set_difference(const Bitset &o) noexcept {
+    m_entry.combine(o.m_entry, 0, Impl_t::words, Combine::Difference);
+  }
+
+  void
+  set_difference(const Parallel &p, const Bitset &o) {
+    combine(p, o, Combine::Difference);
+  }
+
+private:
+  void
+  combine(const Parallel &p, const Bitset &o, Combine op) {
+    for_each_chunk(p, [this, &o, op](size_t, size_t from, size_t to) {
+      m_entry.combine(o.m_entry, from, to, op);
+    });
+  }
+
+public:
+  /**
+   * The changed blocks of a Bitset tracked with DirtyBlocks. $words holds the
+   * words of each block in $blocks after each other, the last block of the
+   * set can be shorter than the block size.
+   */
+  struct Delta {
+    std::vector<size_t> blocks;
+    std::vector<Byte_t> words;
+  };
+
+  /**
+   *  @brief drains the blocks changed since the last collect
+   *  @return the changed blocks and their current words
+   */
+  Delta
+  collect_delta() {
+    static_assert(Dirty::enabled, "Bitset is required to track dirty blocks");
+    Delta result;
+    m_entry.collect(result);
+    return result;
+  }
+
+  /**
+   *  @brief stores the words of $delta, collected from another set of the
+   *         same size, marking the blocks dirty in this set
+   */
+  void
+  apply_delta(const Delta &delta) noexcept {
+    static_assert(Dirty::enabled, "Bitset is required to track dirty blocks");
+    m_entry.apply(delta);
+  }
+
   std::string
   to_string() {
     // this print in an reverse order to << operator
@@ -404,9 +1750,11 @@ public:
   }
 };
 
-template <size_t size, typename Type>
+template <size_t size, typename Type, typename Dirty, typename Storage,
+          typename Order>
 std::ostream &
-operator<<(std::ostream &os, const Bitset<size, Type> &b) {
+operator<<(std::ostream &os,
+           const Bitset<size, Type, Dirty, Storage, Order> &b) {
   for (size_t i = b.size(); i-- > 0;) {
     if (b[i]) {
       os << '1';
@@ -0,0 +1,266 @@
+#include "Bitset.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using sp::Bitset;
+
+/**
+ * Hardware counters of the calling thread, read with perf_event_open. When
+ * the counters can not be opened, e.g. due to perf_event_paranoid or in a
+ * container, available() is false and all values read as zero.
+ */
+struct PerfCounters {
+  enum Counter { CYCLES = 0, INSTRUCTIONS, CACHE_MISSES, COUNTERS };
+
+  uint64_t values[COUNTERS] = {0, 0, 0};
+#if defined(__linux__)
+  int m_fds[COUNTERS] = {-1, -1, -1};
+
+  PerfCounters() noexcept {
+    const uint64_t configs[COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                        PERF_COUNT_HW_INSTRUCTIONS,
+                                        PERF_COUNT_HW_CACHE_MISSES};
+    for (size_t i = 0; i < COUNTERS; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      m_fds[i] = int(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+  }
+
+  ~PerfCounters() noexcept {
+    for (int fd : m_fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  bool
+  available() const noexcept {
+    return m_fds[CYCLES] >= 0;
+  }
+
+  void
+  start() noexcept {
+    for (int fd : m_fds) {
+      if (fd >= 0) {
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  void
+  stop() noexcept {
+    for (size_t i = 0; i < COUNTERS; ++i) {
+      values[i] = 0;
+      if (m_fds[i] >= 0) {
+        ::ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(m_fds[i], &values[i], sizeof(values[i])) !=
+            sizeof(values[i])) {
+          values[i] = 0;
+        }
+      }
+    }
+  }
+#else
+  bool
+  available() const noexcept {
+    return false;
+  }
+
+  void
+  start() noexcept {
+  }
+
+  void
+  stop() noexcept {
+  }
+#endif
+};
+
+/* result of one thread of a workload */
+struct ThreadResult {
+  size_t ops = 0;
+  size_t allocated = 0;
+  uint64_t counters[PerfCounters::COUNTERS] = {0, 0, 0};
+};
+
+/**
+ * Mixed workload: allocate with swap_first, free with set, and read with
+ * find_first and all. Every allocated bit is checked against $owners so a
+ * double allocation is detected. The bits held when the workload stops are
+ * reported so the count of the set can be checked against them.
+ */
+template <typename Bitset_t>
+void
+mixed_workload(Bitset_t &bb, std::vector<std::atomic<uint8_t>> &owners,
+               size_t ops, size_t seed, std::atomic<bool> &failed,
+               ThreadResult &result) {
+  std::mt19937 mt(seed);
+  std::uniform_int_distribution<int> dist(0, 99);
+  std::vector<size_t> held;
+  held.reserve(1024);
+
+  PerfCounters counters;
+  counters.start();
+  for (size_t i = 0; i < ops; ++i) {
+    const int op = dist(mt);
+    if (op < 45) {
+      const size_t idx = bb.swap_first(std::size_t(mt() % bb.size()), true);
+      if (idx != bb.npos) {
+        if (owners[idx].fetch_add(1) != 0) {
+          failed = true;
+        }
+        held.push_back(idx);
+      }
+    } else if (op < 90) {
+      if (!held.empty()) {
+        const size_t idx = held.back();
+        held.pop_back();
+        if (owners[idx].fetch_sub(1) != 1) {
+          failed = true;
+        }
+        if (!bb.set(idx, false)) {
+          failed = true;
+        }
+      }
+    } else if (op < 97) {
+      bb.find_first(false);
+    } else {
+      bb.all(std::size_t(mt() % bb.size()), true);
+    }
+  }
+  counters.stop();
+
+  result.ops = ops;
+  result.allocated = held.size();
+  std::memcpy(result.counters, counters.values, sizeof(result.counters));
+}
+
+class BitsetStressTest : public ::testing::TestWithParam<size_t> {};
+
+INSTANTIATE_TEST_CASE_P(Threads, BitsetStressTest,
+                        ::testing::Values(1, 2, 4, 8));
+
+template <typename Bitset_t>
+void
+run_invariants(size_t threads, size_t ops) {
+  auto bb = std::make_unique<Bitset_t>(false);
+  std::vector<std::atomic<uint8_t>> owners(bb->size());
+  std::atomic<bool> failed(false);
+  std::vector<ThreadResult> results(threads);
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      mixed_workload(*bb, owners, ops, t, failed, results[t]);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  ASSERT_FALSE(failed.load());
+
+  // conserved: the set bits are exactly the bits still held
+  size_t allocated(0);
+  for (const auto &res : results) {
+    allocated += res.allocated;
+  }
+  ASSERT_EQ(allocated, bb->count());
+  for (size_t i = 0; i < bb->size(); ++i) {
+    ASSERT_EQ(owners[i].load() != 0, bb->test(i));
+  }
+}
+
+TEST_P(BitsetStressTest, test_invariants_contended) {
+  // small enough to run out of bits and fight over the same words
+  run_invariants<Bitset<256, uint64_t>>(GetParam(), 200000);
+}
+
+TEST_P(BitsetStressTest, test_invariants_byte) {
+  run_invariants<Bitset<1024, uint8_t>>(GetParam(), 200000);
+}
+
+TEST_P(BitsetStressTest, test_invariants_small) {
+  run_invariants<Bitset<64, uint8_t>>(GetParam(), 200000);
+}
+
+TEST_P(BitsetStressTest, test_invariants_large) {
+  run_invariants<Bitset<1024 * 64, uint64_t>>(GetParam(), 100000);
+}
+
+/**
+ * Reports ops/sec and hardware counters per operation of the mixed workload
+ * for an increasing number of threads. This does not assert on the numbers,
+ * it is there to spot scaling collapse.
+ */
+TEST_F(BitsetStressTest, test_throughput) {
+  using Bitset_t = Bitset<1024 * 64, uint64_t>;
+  constexpr size_t ops(400000);
+  const size_t max_threads = std::max<size_t>(
+      8, size_t(2) * std::thread::hardware_concurrency());
+
+  printf("%8s %12s %12s %12s %14s\n", "threads", "Mops/s", "cycles/op",
+         "instr/op", "cache-miss/op");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    auto bb = std::make_unique<Bitset_t>(false);
+    std::vector<std::atomic<uint8_t>> owners(bb->size());
+    std::atomic<bool> failed(false);
+    std::vector<ThreadResult> results(threads);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        mixed_workload(*bb, owners, ops, t, failed, results[t]);
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    ASSERT_FALSE(failed.load());
+
+    size_t total(0);
+    uint64_t counters[PerfCounters::COUNTERS] = {0, 0, 0};
+    for (const auto &res : results) {
+      total += res.ops;
+      for (size_t i = 0; i < PerfCounters::COUNTERS; ++i) {
+        counters[i] += res.counters[i];
+      }
+    }
+
+    printf("%8zu %12.2f", threads, double(total) / elapsed.count() / 1e6);
+    if (counters[PerfCounters::CYCLES] != 0) {
+      printf(" %12.1f %12.1f %14.3f\n",
+             double(counters[PerfCounters::CYCLES]) / total,
+             double(counters[PerfCounters::INSTRUCTIONS]) / total,
+             double(counters[PerfCounters::CACHE_MISSES]) / total);
+    } else {
+      printf(" %12s %12s %14s\n", "n/a", "n/a", "n/a");
+    }
+  }
+}
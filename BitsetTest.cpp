@@ -1,9 +1,14 @@
 #include "Bitset.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <thread>
+#include <tuple>
 #include <unordered_set>
+#include <vector>
 
 using sp::Bitset;
 using std::cout;
@@ -522,3 +527,763 @@ template <typename T, size_t bits>
 void
 test_threaded_find_fist() {
 }
+
+template <typename T>
+void
+test_swap_batch(bool v) {
+  constexpr size_t bits(1024);
+  Bitset<bits, T> bb{!v};
+  std::array<size_t, 64> out;
+  size_t expected(0);
+  while (true) {
+    size_t cnt = bb.swap_batch(v, out.data(), out.size());
+    if (cnt == 0) {
+      break;
+    }
+    ASSERT_LE(cnt, sizeof(T) * 8);
+    for (size_t i = 0; i < cnt; ++i) {
+      ASSERT_EQ(expected++, out[i]);
+      ASSERT_EQ(v, bb.test(out[i]));
+    }
+  }
+  ASSERT_EQ(bits, expected);
+  ASSERT_TRUE(bb.all(v));
+}
+
+TEST_P(BitsetTest, test_swap_batch_long) {
+  test_swap_batch<uint64_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_swap_batch_int) {
+  test_swap_batch<uint32_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_swap_batch_short) {
+  test_swap_batch<uint16_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_swap_batch_byte) {
+  test_swap_batch<uint8_t>(GetParam());
+}
+
+template <typename T>
+void
+test_parallel_fill_count(bool v) {
+  constexpr size_t bits(1024 * 80);
+  std::string str = random_binary(bits);
+  std::bitset<bits> init(str);
+  Bitset<bits, T> bb{init};
+  for (size_t workers = 1; workers <= 8; ++workers) {
+    sp::Parallel p(workers);
+    ASSERT_EQ(init.count(), bb.count(p));
+  }
+  ASSERT_EQ(init.count(), bb.count());
+
+  bb.fill(sp::Parallel(3), v);
+  ASSERT_TRUE(bb.all(v));
+  ASSERT_EQ(v ? bits : size_t(0), bb.count(sp::Parallel(5)));
+  bb.fill(!v);
+  ASSERT_TRUE(bb.all(!v));
+}
+
+TEST_P(BitsetTest, test_parallel_fill_count_long) {
+  test_parallel_fill_count<uint64_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_parallel_fill_count_byte) {
+  test_parallel_fill_count<uint8_t>(GetParam());
+}
+
+TEST_F(BitsetTest, test_count_partial_word) {
+  Bitset<72, uint64_t> bb{true};
+  ASSERT_EQ(size_t(72), bb.count());
+  ASSERT_EQ(size_t(72), bb.count(sp::Parallel(4)));
+}
+
+template <typename T>
+void
+test_parallel_find_first(bool v) {
+  constexpr size_t bits(1024 * 80);
+  Bitset<bits, T> bb{!v};
+  sp::Parallel p(4);
+  ASSERT_EQ(bb.npos, bb.find_first(p, v));
+  for (size_t i = bits; i > 0;) {
+    i = i > 997 ? i - 997 : 0;
+    ASSERT_TRUE(bb.set(i, v));
+    ASSERT_EQ(i, bb.find_first(p, v));
+    ASSERT_EQ(bb.find_first(v), bb.find_first(p, v));
+  }
+}
+
+TEST_P(BitsetTest, test_parallel_find_first_long) {
+  test_parallel_find_first<uint64_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_parallel_find_first_byte) {
+  test_parallel_find_first<uint8_t>(GetParam());
+}
+
+template <typename T>
+void
+test_set_algebra() {
+  constexpr size_t bits(1024 * 8);
+  std::bitset<bits> a(random_binary(bits));
+  std::bitset<bits> b(reverse(random_binary(bits)));
+  Bitset<bits, T> ba{a};
+  Bitset<bits, T> bb{b};
+  sp::Parallel p(3);
+
+  auto check = [](const std::bitset<bits> &expected,
+                  const Bitset<bits, T> &res) {
+    for (size_t i = 0; i < bits; ++i) {
+      ASSERT_EQ(expected.test(i), res.test(i));
+    }
+  };
+
+  {
+    Bitset<bits, T> res{a};
+    res.set_union(bb);
+    check(a | b, res);
+    Bitset<bits, T> pres{a};
+    pres.set_union(p, bb);
+    check(a | b, pres);
+  }
+  {
+    Bitset<bits, T> res{a};
+    res.set_intersection(bb);
+    check(a & b, res);
+    Bitset<bits, T> pres{a};
+    pres.set_intersection(p, bb);
+    check(a & b, pres);
+  }
+  {
+    Bitset<bits, T> res{a};
+    res.set_difference(bb);
+    check(a & ~b, res);
+    Bitset<bits, T> pres{a};
+    pres.set_difference(p, bb);
+    check(a & ~b, pres);
+  }
+  ASSERT_EQ(a.count(), ba.count());
+}
+
+TEST_F(BitsetTest, test_set_algebra_long) {
+  test_set_algebra<uint64_t>();
+}
+
+TEST_F(BitsetTest, test_set_algebra_byte) {
+  test_set_algebra<uint8_t>();
+}
+
+template <size_t bits, typename T>
+void
+test_small(bool v) {
+  std::string str = random_binary(bits);
+  std::bitset<bits> init(str);
+  Bitset<bits, T> bb{init};
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(init.test(i), bb.test(i));
+  }
+  ASSERT_EQ(init.count(), bb.count());
+
+  bb.fill(!v);
+  ASSERT_TRUE(bb.all(!v));
+  ASSERT_EQ(bb.npos, bb.find_first(v));
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_FALSE(bb.all(i, v));
+    ASSERT_EQ(i, bb.swap_first(v, i + 1));
+    ASSERT_EQ(bb.npos, bb.swap_first(v, i + 1));
+    ASSERT_EQ(size_t(0), bb.find_first(v));
+    ASSERT_EQ(i, bb.find_first(i, v));
+    ASSERT_EQ(i + 1 == bits, bb.all(v));
+    ASSERT_EQ(i + 1 == bits, bb.all(i, v));
+    ASSERT_EQ(v ? i + 1 : bits - i - 1, bb.count());
+  }
+  ASSERT_EQ(bb.npos, bb.swap_first(v));
+  ASSERT_TRUE(bb.all(v));
+
+  for (size_t i = bits; i-- > 0;) {
+    ASSERT_TRUE(bb.set(i, !v));
+    ASSERT_FALSE(bb.set(i, !v));
+    ASSERT_EQ(i, bb.find_first(!v));
+  }
+
+  // a single word set swaps the whole set in one batch
+  std::array<size_t, bits> out;
+  size_t swapped(0);
+  while (true) {
+    size_t cnt =
+        bb.swap_batch(v, out.data() + swapped, out.size() - swapped);
+    if (cnt == 0) {
+      break;
+    }
+    ASSERT_TRUE(bits > 64 || cnt == bits);
+    swapped += cnt;
+  }
+  ASSERT_EQ(bits, swapped);
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(i, out[i]);
+  }
+}
+
+TEST_P(BitsetTest, test_small_8) {
+  test_small<8, uint8_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_24) {
+  test_small<24, uint8_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_32) {
+  test_small<32, uint16_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_64) {
+  test_small<64, uint8_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_8_long) {
+  test_small<8, uint64_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_96) {
+  test_small<96, uint32_t>(GetParam());
+}
+
+TEST_P(BitsetTest, test_small_128) {
+  test_small<128, uint8_t>(GetParam());
+}
+
+TEST_F(BitsetTest, test_small_size) {
+  ASSERT_EQ(sizeof(uint32_t), sizeof(Bitset<24>));
+  ASSERT_EQ(sizeof(uint64_t), sizeof(Bitset<64>));
+#if defined(SP_BITSET_DWCAS)
+  ASSERT_EQ(size_t(16), sizeof(Bitset<128>));
+#endif
+}
+
+TEST_F(BitsetTest, test_small_threaded) {
+  constexpr size_t bits(64);
+  Bitset<bits> bb{false};
+  std::array<std::atomic<size_t>, bits> owners{};
+  std::atomic<bool> failed(false);
+  auto worker = [&] {
+    for (size_t i = 0; i < 10000; ++i) {
+      size_t idx = bb.swap_first(true);
+      if (idx != bb.npos) {
+        // the bit is held by a single thread until released
+        if (owners[idx].fetch_add(1) != 0) {
+          failed = true;
+        }
+        owners[idx].fetch_sub(1);
+        if (!bb.set(idx, false)) {
+          failed = true;
+        }
+      }
+    }
+  };
+  std::thread t1(worker);
+  std::thread t2(worker);
+  t1.join();
+  t2.join();
+  ASSERT_FALSE(failed.load());
+  ASSERT_TRUE(bb.all(false));
+}
+
+template <typename T>
+void
+test_delta() {
+  constexpr size_t bits(1024 * 8);
+  using Bitset_t = Bitset<bits, T, sp::DirtyBlocks<4>>;
+  constexpr size_t block_bits = sizeof(T) * 8 * 4;
+  Bitset_t bb{false};
+  Bitset_t replica{false};
+  ASSERT_TRUE(bb.collect_delta().blocks.empty());
+
+  ASSERT_TRUE(bb.set(3, true));
+  ASSERT_EQ(size_t(0), bb.swap_first(true));
+  ASSERT_TRUE(bb.set(bits - 1, true));
+  ASSERT_TRUE(bb.set(block_bits * 5 + 1, true));
+  ASSERT_FALSE(bb.set(block_bits * 5 + 1, true));
+  {
+    auto delta = bb.collect_delta();
+    ASSERT_EQ((std::vector<size_t>{0, 5, bits / block_bits - 1}),
+              delta.blocks);
+    ASSERT_EQ(size_t(3 * 4), delta.words.size());
+    replica.apply_delta(delta);
+  }
+  ASSERT_TRUE(bb.collect_delta().blocks.empty());
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(bb.test(i), replica.test(i));
+  }
+  // the receiver tracks the applied blocks
+  ASSERT_EQ(size_t(3), replica.collect_delta().blocks.size());
+
+  Bitset_t other{true};
+  bb.set_intersection(sp::Parallel(2), other);
+  ASSERT_TRUE(other.collect_delta().blocks.empty());
+  ASSERT_EQ(bits / block_bits, bb.collect_delta().blocks.size());
+
+  bb.fill(true);
+  replica.apply_delta(bb.collect_delta());
+  ASSERT_TRUE(replica.all(true));
+}
+
+TEST_F(BitsetTest, test_delta_long) {
+  test_delta<uint64_t>();
+}
+
+TEST_F(BitsetTest, test_delta_byte) {
+  test_delta<uint8_t>();
+}
+
+TEST_F(BitsetTest, test_delta_threaded) {
+  constexpr size_t bits(1024 * 8);
+  using Bitset_t = Bitset<bits, uint64_t, sp::DirtyBlocks<1>>;
+  Bitset_t bb{false};
+  Bitset_t replica{false};
+  std::atomic<bool> done(false);
+  std::thread writer([&] {
+    for (size_t i = 0; i < bits; ++i) {
+      bb.swap_first(true);
+    }
+    done = true;
+  });
+  while (!done.load()) {
+    replica.apply_delta(bb.collect_delta());
+  }
+  writer.join();
+  replica.apply_delta(bb.collect_delta());
+  ASSERT_TRUE(replica.all(true));
+}
+
+template <size_t bits, typename T>
+void
+test_range_predicates() {
+  std::string str = random_binary(bits);
+  std::bitset<bits> init(str);
+  Bitset<bits, T> bb{init};
+  std::mt19937 mt(1);
+  std::uniform_int_distribution<size_t> dist(0, bits);
+
+  auto check = [&](size_t begin, size_t end) {
+    size_t ones(0);
+    for (size_t i = begin; i < end; ++i) {
+      ones += init.test(i) ? 1 : 0;
+    }
+    const size_t length = end > begin ? end - begin : 0;
+    ASSERT_EQ(ones, bb.count(begin, end));
+    ASSERT_EQ(ones > 0, bb.any(begin, end, true));
+    ASSERT_EQ(ones < length, bb.any(begin, end, false));
+    ASSERT_EQ(ones == 0, bb.none(begin, end, true));
+    ASSERT_EQ(ones == length, bb.all(begin, end, true));
+    ASSERT_EQ(ones == 0, bb.all(begin, end, false));
+  };
+
+  for (size_t i = 0; i < 2000; ++i) {
+    size_t begin = dist(mt);
+    size_t end = dist(mt);
+    check(std::min(begin, end), std::max(begin, end));
+  }
+  for (size_t i = 0; i < bits; ++i) {
+    check(i, i + 1);
+    check(0, i);
+    check(i, bits);
+  }
+}
+
+TEST_F(BitsetTest, test_range_predicates_long) {
+  test_range_predicates<1024, uint64_t>();
+}
+
+TEST_F(BitsetTest, test_range_predicates_int) {
+  test_range_predicates<1000, uint32_t>();
+}
+
+TEST_F(BitsetTest, test_range_predicates_byte) {
+  test_range_predicates<1024, uint8_t>();
+}
+
+TEST_F(BitsetTest, test_range_predicates_small) {
+  test_range_predicates<56, uint8_t>();
+  test_range_predicates<120, uint64_t>();
+}
+
+TEST_P(BitsetTest, test_range_window) {
+  constexpr size_t bits(1024 * 16);
+  const bool v = GetParam();
+  Bitset<bits, uint64_t> bb{v};
+  ASSERT_TRUE(bb.all(4096, 8192, v));
+  ASSERT_TRUE(bb.set(8191, !v));
+  ASSERT_FALSE(bb.all(4096, 8192, v));
+  ASSERT_TRUE(bb.all(4096, 8191, v));
+  ASSERT_TRUE(bb.all(8192, bits, v));
+  ASSERT_TRUE(bb.any(0, bits, !v));
+  ASSERT_TRUE(bb.all(10, 10, !v));
+  ASSERT_FALSE(bb.any(10, 10, v));
+}
+
+template <size_t bits, typename T>
+static void
+test_swap_near_exhaust(bool v) {
+  Bitset<bits, T> bb{!v};
+  std::mt19937 mt(2);
+  std::uniform_int_distribution<size_t> dist(0, bits - 1);
+  for (size_t i = 0; i < bits; ++i) {
+    const size_t hint = dist(mt);
+    const size_t radius = i % 2 == 0 ? bits : 16;
+    const size_t idx = bb.swap_first_near(hint, v, radius);
+    if (idx == bb.npos) {
+      // nothing left within the radius
+      const size_t low = hint > radius ? hint - radius : 0;
+      const size_t high = std::min(bits, hint + radius + 1);
+      ASSERT_TRUE(bb.all(low, high, v));
+      ASSERT_NE(size_t(bits), radius);
+      continue;
+    }
+    ASSERT_LT(idx, bits);
+    ASSERT_EQ(v, bb.test(idx));
+    ASSERT_LE(std::max(idx, hint) - std::min(idx, hint), radius);
+  }
+  for (size_t i = 0; i < bits; ++i) {
+    bb.swap_first_near(dist(mt), v);
+  }
+  ASSERT_TRUE(bb.all(v));
+  ASSERT_EQ(bb.npos, bb.swap_first_near(dist(mt), v));
+}
+
+TEST_P(BitsetTest, test_swap_near_exhaust) {
+  const bool v = GetParam();
+  test_swap_near_exhaust<1024 * 8, uint64_t>(v);
+  test_swap_near_exhaust<1024, uint8_t>(v);
+  test_swap_near_exhaust<1000, uint32_t>(v);
+  test_swap_near_exhaust<64, uint8_t>(v);
+  test_swap_near_exhaust<120, uint64_t>(v);
+}
+
+TEST_P(BitsetTest, test_swap_near_word) {
+  const bool v = GetParam();
+  Bitset<1024, uint64_t> bb{!v};
+  // closest first, the following bit on a tie
+  ASSERT_EQ(size_t(70), bb.swap_first_near(70, v));
+  ASSERT_EQ(size_t(71), bb.swap_first_near(70, v));
+  ASSERT_EQ(size_t(69), bb.swap_first_near(70, v));
+  ASSERT_EQ(size_t(72), bb.swap_first_near(70, v));
+  ASSERT_EQ(size_t(68), bb.swap_first_near(70, v));
+
+  Bitset<64, uint8_t> small{!v};
+  ASSERT_EQ(size_t(63), small.swap_first_near(63, v));
+  ASSERT_EQ(size_t(62), small.swap_first_near(63, v));
+  ASSERT_EQ(size_t(0), small.swap_first_near(0, v));
+  ASSERT_EQ(size_t(1), small.swap_first_near(0, v));
+  ASSERT_EQ(small.npos, small.swap_first_near(64, v));
+}
+
+/**
+ * checks swap_first_near against a reference which picks the nearest free
+ * bit on the cache line of the hint, then on its page, then anywhere. the
+ * lines and pages are computed from $first, the address of word 0
+ */
+template <typename Bitset_t>
+static void
+test_swap_near_locality(Bitset_t &bb, const void *first, bool v) {
+  const uintptr_t base = reinterpret_cast<uintptr_t>(first);
+  auto group = [&](size_t bit, size_t bytes) {
+    return (base + bit / 64 * sizeof(uint64_t)) / bytes;
+  };
+
+  std::vector<size_t> free = {100, 511, 1000, 5000, 32767, 40000};
+  for (size_t bit : free) {
+    ASSERT_TRUE(bb.set(bit, !v));
+  }
+  const size_t hints[] = {512, 512, 512, 32768, bb.size() - 1, 0, 0};
+  for (size_t hint : hints) {
+    auto key = [&](size_t bit) {
+      const size_t level = group(bit, 64) == group(hint, 64)       ? 0
+                           : group(bit, 4096) == group(hint, 4096) ? 1
+                                                                   : 2;
+      const long words = long(bit / 64) - long(hint / 64);
+      return std::make_tuple(level, std::labs(words), words < 0,
+                             std::labs(long(bit) - long(hint)), bit < hint);
+    };
+    auto it = std::min_element(free.begin(), free.end(),
+                               [&](size_t a, size_t b) {
+                                 return key(a) < key(b);
+                               });
+    if (it == free.end()) {
+      ASSERT_EQ(bb.npos, bb.swap_first_near(hint, v));
+      continue;
+    }
+    ASSERT_EQ(*it, bb.swap_first_near(hint, v));
+    free.erase(it);
+  }
+  ASSERT_TRUE(free.empty());
+}
+
+TEST_P(BitsetTest, test_swap_near_locality) {
+  const bool v = GetParam();
+  constexpr size_t bits(1024 * 128);
+  constexpr size_t words(bits / 64);
+  using View_t = Bitset<bits, uint64_t, sp::Untracked, sp::ExternalStorage>;
+
+  // words placed at different offsets from a page boundary
+  std::vector<uint64_t> buffer(words + 1024);
+  const size_t page =
+      (4096 - reinterpret_cast<uintptr_t>(buffer.data()) % 4096) % 4096 / 8;
+  for (size_t offset : {0, 1, 3, 7, 8, 100, 511}) {
+    uint64_t *first = buffer.data() + page + offset;
+    std::fill(first, first + words, v ? ~uint64_t(0) : uint64_t(0));
+    View_t view(first);
+    test_swap_near_locality(view, first, v);
+  }
+
+  // 511 is on the line of 512 when word 0 is 8 bytes into a line
+  {
+    uint64_t *first = buffer.data() + page + 1;
+    std::fill(first, first + words, v ? ~uint64_t(0) : uint64_t(0));
+    View_t view(first);
+    ASSERT_TRUE(view.set(511, !v));
+    ASSERT_TRUE(view.set(1000, !v));
+    ASSERT_EQ(size_t(511), view.swap_first_near(512, v));
+  }
+
+  // inline words 8 bytes into a line, which is the first member of the set
+  struct Misaligned {
+    alignas(64) uint64_t pad;
+    Bitset<bits, uint64_t> bb;
+
+    explicit Misaligned(bool b)
+        : pad(0)
+        , bb(b) {
+    }
+  };
+  auto misaligned = std::make_unique<Misaligned>(v);
+  const void *first = &misaligned->bb;
+  ASSERT_EQ(size_t(8), reinterpret_cast<uintptr_t>(first) % 64);
+  ASSERT_TRUE(misaligned->bb.set(0, !v));
+  ASSERT_EQ(v ? ~(uint64_t(1) << 63) : uint64_t(1) << 63,
+            *static_cast<const uint64_t *>(first));
+  ASSERT_TRUE(misaligned->bb.set(0, v));
+  test_swap_near_locality(misaligned->bb, first, v);
+}
+
+TEST_P(BitsetTest, test_swap_near_radius) {
+  const bool v = GetParam();
+  Bitset<1024, uint8_t> bb{v};
+  ASSERT_TRUE(bb.set(100, !v));
+  ASSERT_EQ(bb.npos, bb.swap_first_near(200, v, 99));
+  ASSERT_EQ(bb.npos, bb.swap_first_near(0, v, 99));
+  ASSERT_EQ(size_t(100), bb.swap_first_near(200, v, 100));
+  ASSERT_EQ(bb.npos, bb.swap_first_near(100, v));
+
+  ASSERT_TRUE(bb.set(1023, !v));
+  ASSERT_EQ(bb.npos, bb.swap_first_near(1000, v, 0));
+  ASSERT_EQ(size_t(1023), bb.swap_first_near(1023, v, 0));
+  ASSERT_TRUE(bb.set(0, !v));
+  ASSERT_EQ(size_t(0), bb.swap_first_near(5, v, size_t(-1)));
+}
+
+/**
+ * the bit order only changes where a bit is stored, so the same operations
+ * on an MsbFirst and an LsbFirst set give the same results
+ */
+template <size_t bits, typename T>
+static void
+test_bit_order(bool v) {
+  using Msb_t = Bitset<bits, T, sp::Untracked, sp::InlineStorage>;
+  using Lsb_t =
+      Bitset<bits, T, sp::Untracked, sp::InlineStorage, sp::LsbFirst>;
+  Msb_t msb{v};
+  Lsb_t lsb{v};
+  std::mt19937 mt(3);
+  std::uniform_int_distribution<size_t> dist(0, bits - 1);
+  for (size_t i = 0; i < bits * 4; ++i) {
+    const size_t idx = dist(mt);
+    const size_t end = dist(mt) + 1;
+    switch (i % 7) {
+    case 0:
+      ASSERT_EQ(msb.set(idx, !v), lsb.set(idx, !v));
+      break;
+    case 1:
+      ASSERT_EQ(msb.swap_first(idx, v, end), lsb.swap_first(idx, v, end));
+      break;
+    case 2:
+      ASSERT_EQ(msb.swap_first_near(idx, !v), lsb.swap_first_near(idx, !v));
+      break;
+    case 3: {
+      size_t msb_out[8];
+      size_t lsb_out[8];
+      const size_t cnt = msb.swap_batch(idx, v, msb_out, 8);
+      ASSERT_EQ(cnt, lsb.swap_batch(idx, v, lsb_out, 8));
+      for (size_t k = 0; k < cnt; ++k) {
+        ASSERT_EQ(msb_out[k], lsb_out[k]);
+      }
+    } break;
+    case 4:
+      ASSERT_EQ(msb.find_first(idx, true), lsb.find_first(idx, true));
+      ASSERT_EQ(msb.find_first(idx, false), lsb.find_first(idx, false));
+      break;
+    default:
+      ASSERT_EQ(msb.all(idx, true), lsb.all(idx, true));
+      ASSERT_EQ(msb.count(idx, end), lsb.count(idx, end));
+      ASSERT_EQ(msb.any(idx, end, v), lsb.any(idx, end, v));
+      break;
+    }
+  }
+  ASSERT_EQ(msb.count(), lsb.count());
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(msb.test(i), lsb.test(i));
+  }
+}
+
+TEST_P(BitsetTest, test_bit_order) {
+  const bool v = GetParam();
+  test_bit_order<1024, uint64_t>(v);
+  test_bit_order<1000, uint32_t>(v);
+  test_bit_order<1024, uint8_t>(v);
+  test_bit_order<24, uint8_t>(v);
+  test_bit_order<64, uint8_t>(v);
+  test_bit_order<120, uint64_t>(v);
+}
+
+template <size_t bits, typename T, typename Order>
+static void
+test_word_layout() {
+  constexpr size_t width = sizeof(T) * 8;
+  Bitset<bits, T, sp::Untracked, sp::InlineStorage, Order> bb{false};
+  ASSERT_EQ((bits + width - 1) / width, bb.words());
+
+  std::mt19937 mt(4);
+  std::vector<T> words(bb.words(), T(0));
+  for (size_t i = 0; i < bits; ++i) {
+    if (mt() % 3 == 0) {
+      ASSERT_TRUE(bb.set(i, true));
+      const size_t offset = Order::lsb ? i % width : width - 1 - i % width;
+      words[i / width] = T(words[i / width] | T(T(1) << offset));
+    }
+  }
+  std::vector<T> out(bb.words() + 1, T(0));
+  ASSERT_EQ(bb.words(), bb.copy_words(out.data(), out.size()));
+  for (size_t i = 0; i < bb.words(); ++i) {
+    ASSERT_EQ(words[i], out[i]);
+  }
+
+  Bitset<bits, T, sp::Untracked, sp::InlineStorage, Order> copy{true};
+  ASSERT_EQ(bb.words(), copy.assign_words(words.data(), words.size() + 1));
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(bb.test(i), copy.test(i));
+  }
+  ASSERT_EQ(bb.count(), copy.count());
+
+  // only the first word is assigned
+  const T ones = T(~T(0));
+  ASSERT_EQ(size_t(1), copy.assign_words(&ones, 1));
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(i < width || bb.test(i), copy.test(i));
+  }
+}
+
+TEST_F(BitsetTest, test_word_layout_lsb) {
+  test_word_layout<1024, uint64_t, sp::LsbFirst>();
+  test_word_layout<1000, uint32_t, sp::LsbFirst>();
+  test_word_layout<256, uint8_t, sp::LsbFirst>();
+  test_word_layout<24, uint8_t, sp::LsbFirst>();
+  test_word_layout<64, uint16_t, sp::LsbFirst>();
+  test_word_layout<128, uint64_t, sp::LsbFirst>();
+}
+
+TEST_F(BitsetTest, test_word_layout_msb) {
+  test_word_layout<1024, uint64_t, sp::MsbFirst>();
+  test_word_layout<256, uint8_t, sp::MsbFirst>();
+  test_word_layout<24, uint8_t, sp::MsbFirst>();
+  test_word_layout<128, uint64_t, sp::MsbFirst>();
+}
+
+TEST_F(BitsetTest, test_std_bitset_lsb) {
+  constexpr size_t bits(200);
+  std::bitset<bits> init;
+  for (size_t i = 0; i < bits; i += 3) {
+    init.set(i);
+  }
+  Bitset<bits, uint64_t, sp::Untracked, sp::InlineStorage, sp::LsbFirst> bb{
+      init};
+  uint64_t out[4];
+  ASSERT_EQ(size_t(4), bb.copy_words(out, 4));
+  // the low word of std::bitset, with bit 0 in the least significant bit
+  ASSERT_EQ((init & std::bitset<bits>(~uint64_t(0))).to_ullong(), out[0]);
+  for (size_t i = 0; i < bits; ++i) {
+    ASSERT_EQ(init.test(i), bb.test(i));
+  }
+}
+
+TEST_F(BitsetTest, test_external_view) {
+  // an Arrow style validity buffer, bit i in bit i % 8 of byte i / 8
+  alignas(8) uint8_t validity[16] = {0};
+  validity[0] = 0x05;
+  validity[3] = 0x80;
+  using View_t =
+      Bitset<128, uint8_t, sp::Untracked, sp::ExternalStorage, sp::LsbFirst>;
+  View_t view(validity);
+  ASSERT_EQ(size_t(16), view.words());
+  ASSERT_TRUE(view.test(0));
+  ASSERT_FALSE(view.test(1));
+  ASSERT_TRUE(view.test(2));
+  ASSERT_TRUE(view.test(31));
+  ASSERT_EQ(size_t(3), view.count());
+  ASSERT_EQ(size_t(0), view.find_first(true));
+  ASSERT_EQ(size_t(31), view.find_first(3, true));
+
+  // changes are made in place
+  ASSERT_EQ(size_t(1), view.swap_first(true));
+  ASSERT_EQ(uint8_t(0x07), validity[0]);
+  ASSERT_TRUE(view.set(127, true));
+  ASSERT_EQ(uint8_t(0x80), validity[15]);
+  ASSERT_TRUE(view.set(31, false));
+  ASSERT_EQ(uint8_t(0), validity[3]);
+
+  // and seen by the view
+  validity[8] = 0xff;
+  ASSERT_TRUE(view.all(64, 72, true));
+  ASSERT_EQ(size_t(12), view.count());
+
+  alignas(8) uint64_t words[2] = {0, 0};
+  Bitset<128, uint64_t, sp::Untracked, sp::ExternalStorage, sp::LsbFirst> wide(
+      words);
+  wide.fill(true);
+  ASSERT_EQ(~uint64_t(0), words[0]);
+  ASSERT_EQ(~uint64_t(0), words[1]);
+  ASSERT_EQ(size_t(70), wide.swap_first(70, false));
+  ASSERT_EQ(~(uint64_t(1) << 6), words[1]);
+}
+
+TEST_P(BitsetTest, test_external_view_threaded) {
+  const bool v = GetParam();
+  constexpr size_t bits(1024 * 8);
+  std::vector<uint64_t> words(bits / 64, v ? ~uint64_t(0) : uint64_t(0));
+  Bitset<bits, uint64_t, sp::Untracked, sp::ExternalStorage, sp::LsbFirst>
+      view(words.data());
+
+  std::vector<std::thread> workers;
+  std::vector<std::vector<size_t>> taken(4);
+  for (size_t t = 0; t < taken.size(); ++t) {
+    workers.emplace_back([&, t] {
+      size_t idx;
+      while ((idx = view.swap_first(!v)) != view.npos) {
+        taken[t].push_back(idx);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  std::unordered_set<size_t> seen;
+  for (const auto &ts : taken) {
+    for (size_t idx : ts) {
+      ASSERT_TRUE(seen.insert(idx).second);
+    }
+  }
+  ASSERT_EQ(bits, seen.size());
+  for (uint64_t word : words) {
+    ASSERT_EQ(v ? uint64_t(0) : ~uint64_t(0), word);
+  }
+}
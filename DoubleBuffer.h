@@ -0,0 +1,178 @@
+#ifndef SP_CONCURRENT_DOUBLE_BUFFER_H
+#define SP_CONCURRENT_DOUBLE_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sp {
+
+/**
+ * Two Bitsets of which one is published to readers while the other is
+ * rebuilt off to the side. A rebuild is published with a single atomic
+ * pointer swap, so readers never observe a partially built set.
+ *
+ * Each buffer counts its readers. A reader registers with the published
+ * buffer and checks that it is still published, otherwise it retries on the
+ * new one. The writer reuses an unpublished buffer once its readers have
+ * left. If every unpublished buffer is still pinned it is left to its readers
+ * and the writer allocates another one instead of waiting. Normally the two
+ * buffers alternate, and a further buffer is only allocated per reader living
+ * across more than one update. The reader side is wait and allocation free
+ * and the writer side never waits for readers.
+ */
+template <typename Bitset_t>
+class DoubleBuffer {
+private:
+  struct Buffer {
+    Bitset_t bitset;
+    alignas(64) std::atomic<size_t> readers;
+
+    explicit Buffer(bool v) //
+        : bitset(v)
+        , readers(0) {
+    }
+  };
+
+  // only accessed by the writer holding $m_writer
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+  std::atomic<Buffer *> m_current;
+  std::mutex m_writer;
+  const bool m_init;
+
+public:
+  /**
+   * Pins the buffer published when it was created until destroyed. Readers
+   * should be short lived since they hold back the next rebuild.
+   */
+  class Reader {
+  private:
+    Buffer *m_buffer;
+
+  public:
+    explicit Reader(Buffer *buffer) noexcept //
+        : m_buffer(buffer) {
+    }
+
+    Reader(const Reader &) = delete;
+    Reader(Reader &&o) noexcept //
+        : m_buffer(o.m_buffer) {
+      o.m_buffer = nullptr;
+    }
+
+    Reader &
+    operator=(const Reader &) = delete;
+    Reader &
+    operator=(Reader &&) = delete;
+
+    ~Reader() noexcept {
+      if (m_buffer != nullptr) {
+        m_buffer->readers.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    const Bitset_t &operator*() const noexcept {
+      return m_buffer->bitset;
+    }
+
+    const Bitset_t *operator->() const noexcept {
+      return &m_buffer->bitset;
+    }
+  };
+
+  /**
+   *  @param  v  the value the buffers are filled with
+   *  @throw  std::bad_alloc  if the buffers could not be allocated
+   */
+  explicit DoubleBuffer(bool v = false)
+      : m_buffers()
+      , m_current(nullptr)
+      , m_writer()
+      , m_init(v) {
+    m_buffers.push_back(std::make_unique<Buffer>(v));
+    m_buffers.push_back(std::make_unique<Buffer>(v));
+    m_current.store(m_buffers[0].get());
+  }
+
+  DoubleBuffer(const DoubleBuffer &) = delete;
+  DoubleBuffer(DoubleBuffer &&) = delete;
+
+  DoubleBuffer &
+  operator=(const DoubleBuffer &) = delete;
+  DoubleBuffer &
+  operator=(DoubleBuffer &&) = delete;
+
+  /**
+   *  @brief pins the published buffer. a Reader held across updates, also
+   *         by the thread calling update(), does not block them but keeps
+   *         its buffer from being reused, so an update allocates a buffer
+   *         if every unpublished one is pinned
+   */
+  Reader
+  read() const noexcept {
+    while (true) {
+      Buffer *buffer = m_current.load();
+      buffer->readers.fetch_add(1);
+      /**
+       * if the buffer was replaced before we registered the writer might
+       * allready be rebuilding it, so we retry on the published one
+       */
+      if (m_current.load() == buffer) {
+        return Reader(buffer);
+      }
+      buffer->readers.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  /**
+   *  @brief rebuilds an unpublished buffer with $build(next, current) and
+   *         publishes it. $next holds an older generation, or the initial
+   *         value if it was just allocated. writers are serialised
+   *  @throw  std::bad_alloc  if a buffer was required but could not be
+   *          allocated, nothing is published then
+   */
+  template <typename F>
+  void
+  update(F build) {
+    std::lock_guard<std::mutex> guard(m_writer);
+    Buffer *current = m_current.load();
+    Buffer *next = idle(current);
+    if (next == nullptr) {
+      m_buffers.push_back(std::make_unique<Buffer>(m_init));
+      next = m_buffers.back().get();
+    }
+
+    build(next->bitset, static_cast<const Bitset_t &>(current->bitset));
+    m_current.store(next);
+  }
+
+  /**
+   *  @return the number of allocated buffers
+   */
+  size_t
+  buffers() {
+    std::lock_guard<std::mutex> guard(m_writer);
+    return m_buffers.size();
+  }
+
+private:
+  /**
+   * an unpublished buffer without readers. a reader which registers after
+   * the check retries since the buffer is not published
+   */
+  Buffer *
+  idle(Buffer *current) noexcept {
+    for (auto &buffer : m_buffers) {
+      if (buffer.get() != current && buffer->readers.load() == 0) {
+        return buffer.get();
+      }
+    }
+    return nullptr;
+  }
+};
+
+} // namespace sp
+
+#endif
@@ -0,0 +1,121 @@
+#include "Bitset.h"
+#include "DoubleBuffer.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using sp::Bitset;
+using sp::DoubleBuffer;
+
+class DoubleBufferTest : public ::testing::Test {};
+
+using Mask_t = Bitset<1024 * 64, uint64_t>;
+
+TEST_F(DoubleBufferTest, test_update) {
+  DoubleBuffer<Mask_t> db(false);
+  {
+    auto reader = db.read();
+    ASSERT_TRUE(reader->all(false));
+  }
+
+  db.update([](Mask_t &next, const Mask_t &current) {
+    ASSERT_TRUE(current.all(false));
+    next.fill(false);
+    next.set(10, true);
+    next.set(20, true);
+  });
+  {
+    auto reader = db.read();
+    ASSERT_EQ(size_t(2), reader->count());
+    ASSERT_TRUE((*reader)[10]);
+  }
+
+  // rebuild from the published set
+  db.update([](Mask_t &next, const Mask_t &current) {
+    next.fill(false);
+    next.set_union(current);
+    next.set(30, true);
+  });
+  auto reader = db.read();
+  ASSERT_EQ(size_t(3), reader->count());
+  ASSERT_TRUE(reader->test(30));
+}
+
+TEST_F(DoubleBufferTest, test_readers_pin) {
+  DoubleBuffer<Mask_t> db(false);
+  auto before = db.read();
+  db.update([](Mask_t &next, const Mask_t &) { next.fill(true); });
+  // the pinned reader still sees the buffer it was created with
+  ASSERT_TRUE(before->all(false));
+  ASSERT_TRUE(db.read()->all(true));
+}
+
+TEST_F(DoubleBufferTest, test_readers_across_updates) {
+  DoubleBuffer<Mask_t> db(false);
+  // held by the updating thread across several updates
+  auto first = db.read();
+  db.update([](Mask_t &next, const Mask_t &) { next.fill(true); });
+  auto second = db.read();
+  db.update([](Mask_t &next, const Mask_t &) { next.fill(false); });
+  db.update([](Mask_t &next, const Mask_t &) {
+    next.fill(false);
+    next.set(1, true);
+  });
+  ASSERT_EQ(size_t(4), db.buffers());
+  ASSERT_TRUE(first->all(false));
+  ASSERT_TRUE(second->all(true));
+  ASSERT_EQ(size_t(1), db.read()->count());
+
+  // released buffers are reused
+  {
+    auto drop = std::move(first);
+  }
+  {
+    auto drop = std::move(second);
+  }
+  for (size_t i = 0; i < 10; ++i) {
+    db.update([i](Mask_t &next, const Mask_t &) { next.fill(i % 2 == 0); });
+    auto reader = db.read();
+    ASSERT_TRUE(reader->all(i % 2 == 0));
+  }
+  ASSERT_EQ(size_t(4), db.buffers());
+}
+
+TEST_F(DoubleBufferTest, test_threaded) {
+  DoubleBuffer<Mask_t> db(false);
+  std::atomic<bool> done(false);
+  std::atomic<bool> failed(false);
+  std::atomic<size_t> reads(0);
+
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 3; ++i) {
+    readers.emplace_back([&] {
+      while (!done.load()) {
+        auto reader = db.read();
+        // each published generation is either all set or all unset
+        const bool v = reader->test(0);
+        if (!reader->all(v)) {
+          failed = true;
+        }
+        ++reads;
+      }
+    });
+  }
+
+  for (size_t gen = 1; gen <= 200; ++gen) {
+    db.update([gen](Mask_t &next, const Mask_t &) {
+      const bool v = gen % 2 == 1;
+      for (size_t i = 0; i < next.size(); ++i) {
+        next.set(i, v);
+      }
+    });
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  ASSERT_FALSE(failed.load());
+  ASSERT_GT(reads.load(), size_t(0));
+  ASSERT_TRUE(db.read()->all(false));
+}
@@ -0,0 +1,347 @@
+#ifndef SP_CONCURRENT_FIELD_ARRAY_H
+#define SP_CONCURRENT_FIELD_ARRAY_H
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace sp {
+
+/**
+ * Packed array of 2 or 4 bit fields, each field holding a small state such as
+ * free, reserved, live or draining. Fields share the atomic words of the
+ * backing storage so a state transition is a single CAS, and a word worth of
+ * fields is matched at once using SWAR compares.
+ *
+ * |word|word|...|
+ * ^         ^
+ * |field 0  |high field
+ *
+ * field 0 of a word is stored in its most significant bits, like Bitset.
+ *
+ * Values wider than a field are truncated to the field width by every
+ * operation, both values written and values compared against.
+ */
+template <size_t T_Fields, size_t T_Field_Bits = 2, typename Word_t = uint64_t>
+class FieldArray {
+public:
+  static constexpr size_t npos = T_Fields;
+  using Field_t = uint8_t;
+
+private:
+  static_assert(T_Field_Bits == 2 || T_Field_Bits == 4,
+                "Field width is required to be 2 or 4 bits");
+  static_assert(std::is_integral<Word_t>::value &&
+                    std::is_unsigned<Word_t>::value,
+                "Backing structure is required to be an unsigned integral");
+  static_assert(sizeof(Word_t) <= sizeof(unsigned long long),
+                "Backing structure is required to fit in a long long");
+
+  using Entry_t = std::atomic<Word_t>;
+  static constexpr size_t bits = sizeof(Word_t) * 8;
+  static constexpr size_t per_word = bits / T_Field_Bits;
+  static constexpr size_t T_Words = (T_Fields + per_word - 1) / per_word;
+  static constexpr Word_t field_mask = Word_t((1u << T_Field_Bits) - 1);
+
+  /* the least significant bit of every field: 0101...01 */
+  static constexpr Word_t
+  low_bits() noexcept {
+    Word_t result(0);
+    for (size_t i = 0; i < per_word; ++i) {
+      result = Word_t(result | Word_t(Word_t(1) << (i * T_Field_Bits)));
+    }
+    return result;
+  }
+
+  static constexpr Word_t low_ = low_bits();
+
+  std::array<Entry_t, T_Words> m_data;
+
+public:
+  explicit FieldArray(Field_t init = 0) noexcept //
+      : m_data() {
+    fill(init);
+  }
+
+  FieldArray(const FieldArray &) = delete;
+  FieldArray(FieldArray &&) = delete;
+
+  FieldArray &
+  operator=(const FieldArray &) = delete;
+  FieldArray &
+  operator=(FieldArray &&) = delete;
+
+  ~FieldArray() noexcept {
+  }
+
+  constexpr size_t
+  size() const noexcept {
+    return T_Fields;
+  }
+
+  Field_t
+  get(size_t idx) const noexcept {
+    if (idx >= T_Fields) {
+      return 0;
+    }
+    const Word_t word = m_data[idx / per_word].load();
+    return Field_t((word >> shift(idx % per_word)) & field_mask);
+  }
+
+  Field_t operator[](size_t idx) const noexcept {
+    return get(idx);
+  }
+
+  /**
+   *  @brief sets the field at $idx to $value
+   *  @return the previous value of the field, 0 if $idx is out of range
+   */
+  Field_t
+  set(size_t idx, Field_t value) noexcept {
+    if (idx >= T_Fields) {
+      return 0;
+    }
+    auto &entry = m_data[idx / per_word];
+    const size_t sh = shift(idx % per_word);
+    const Word_t mask = Word_t(field_mask << sh);
+
+    Word_t word = entry.load();
+    Word_t next;
+    do {
+      next = Word_t((word & Word_t(~mask)) | place(value, sh));
+    } while (!entry.compare_exchange_strong(word, next));
+    return Field_t((word >> sh) & field_mask);
+  }
+
+  /**
+   *  @brief sets the field at $idx to $desired if it is $expected, using a
+   *         single CAS
+   *  @return true if the field was changed, false if it was not $expected or
+   *          allready $desired
+   */
+  bool
+  compare_and_set_field(size_t idx, Field_t expected,
+                        Field_t desired) noexcept {
+    expected = Field_t(expected & field_mask);
+    desired = Field_t(desired & field_mask);
+    if (idx >= T_Fields || expected == desired) {
+      return false;
+    }
+    auto &entry = m_data[idx / per_word];
+    const size_t sh = shift(idx % per_word);
+    const Word_t mask = Word_t(field_mask << sh);
+
+    Word_t word = entry.load();
+    do {
+      if (Field_t((word >> sh) & field_mask) != expected) {
+        return false;
+      }
+      /**
+       * if the compare exchange fails $word is updated with the current
+       * value and the field is checked again
+       */
+    } while (!entry.compare_exchange_strong(
+        word, Word_t((word & Word_t(~mask)) | place(desired, sh))));
+    return true;
+  }
+
+  /**
+   *  @brief finds the first field starting from $idx equal to $value
+   *  @return the index of the field or npos
+   */
+  size_t
+  find_first_field(size_t idx, Field_t value) const noexcept {
+    for (size_t wordIdx = idx / per_word; wordIdx < T_Words; ++wordIdx) {
+      const Word_t word = m_data[wordIdx].load();
+      const Word_t found =
+          Word_t(matches(word, value) & range(wordIdx, idx, T_Fields));
+      if (found != Word_t(0)) {
+        return wordIdx * per_word + first(found);
+      }
+    }
+    return npos;
+  }
+
+  size_t
+  find_first_field(Field_t value) const noexcept {
+    return find_first_field(size_t(0), value);
+  }
+
+  /**
+   *  @brief finds the first field starting from $idx equal to $expected and
+   *         changes it to $desired with a single CAS
+   *  @return the index of the changed field or npos
+   */
+  size_t
+  swap_first_field(size_t idx, Field_t expected, Field_t desired) noexcept {
+    for (size_t wordIdx = idx / per_word; wordIdx < T_Words; ++wordIdx) {
+      auto &entry = m_data[wordIdx];
+      Word_t word = entry.load(std::memory_order_acquire);
+      while (true) {
+        const Word_t found =
+            Word_t(matches(word, expected) & range(wordIdx, idx, T_Fields));
+        if (found == Word_t(0)) {
+          break;
+        }
+        const size_t field = first(found);
+        const size_t sh = shift(field);
+        const Word_t next =
+            Word_t((word & Word_t(~Word_t(field_mask << sh))) |
+                   place(desired, sh));
+        if (entry.compare_exchange_strong(word, next)) {
+          return wordIdx * per_word + field;
+        }
+      }
+    }
+    return npos;
+  }
+
+  size_t
+  swap_first_field(Field_t expected, Field_t desired) noexcept {
+    return swap_first_field(size_t(0), expected, desired);
+  }
+
+  /**
+   *  @brief changes every field in [begin, end) which is $from to $to, with
+   *         one CAS per word
+   *  @return the number of changed fields
+   */
+  size_t
+  transition(size_t begin, size_t end, Field_t from, Field_t to) noexcept {
+    if (end > T_Fields) {
+      end = T_Fields;
+    }
+    size_t result(0);
+    if (begin >= end) {
+      return result;
+    }
+    for (size_t wordIdx = begin / per_word; wordIdx * per_word < end;
+         ++wordIdx) {
+      auto &entry = m_data[wordIdx];
+      const Word_t fields = range(wordIdx, begin, end);
+      Word_t word = entry.load();
+      Word_t found;
+      Word_t next;
+      do {
+        found = Word_t(matches(word, from) & fields);
+        if (found == Word_t(0)) {
+          break;
+        }
+        const Word_t mask = Word_t(found * field_mask);
+        next = Word_t((word & Word_t(~mask)) | Word_t(replicate(to) & mask));
+      } while (!entry.compare_exchange_strong(word, next));
+      result += popcount(found);
+    }
+    return result;
+  }
+
+  size_t
+  transition(Field_t from, Field_t to) noexcept {
+    return transition(size_t(0), T_Fields, from, to);
+  }
+
+  /**
+   *  @return the number of fields equal to $value
+   */
+  size_t
+  count(Field_t value) const noexcept {
+    size_t result(0);
+    for (size_t wordIdx = 0; wordIdx < T_Words; ++wordIdx) {
+      const Word_t word = m_data[wordIdx].load();
+      result +=
+          popcount(Word_t(matches(word, value) & range(wordIdx, 0, T_Fields)));
+    }
+    return result;
+  }
+
+  void
+  fill(Field_t value) noexcept {
+    for (auto &entry : m_data) {
+      entry.store(replicate(value));
+    }
+  }
+
+private:
+  /* bit offset of the field $field in a word */
+  static constexpr size_t
+  shift(size_t field) noexcept {
+    return bits - (field + 1) * T_Field_Bits;
+  }
+
+  /* $value truncated to the field width, shifted by $sh */
+  static constexpr Word_t
+  place(Field_t value, size_t sh) noexcept {
+    return Word_t(Word_t(value & field_mask) << sh);
+  }
+
+  /* $value in every field of the word */
+  static constexpr Word_t
+  replicate(Field_t value) noexcept {
+    return Word_t(low_ * Word_t(value & field_mask));
+  }
+
+  /**
+   * the least significant bit of every field in $word equal to $value. the
+   * fields are xor:ed with the pattern, leaving the matching fields zero, and
+   * the bits of each field are or:ed into its least significant bit
+   */
+  static constexpr Word_t
+  matches(Word_t word, Field_t value) noexcept {
+    const Word_t diff = Word_t(word ^ replicate(value));
+    Word_t folded = diff;
+    for (size_t i = 1; i < T_Field_Bits; ++i) {
+      folded = Word_t(folded | Word_t(diff >> i));
+    }
+    return Word_t(Word_t(~folded) & low_);
+  }
+
+  /**
+   * the least significant bit of every field in word $wordIdx with an index
+   * greater or equal to $idx
+   */
+  static constexpr Word_t
+  window(size_t wordIdx, size_t idx) noexcept {
+    const size_t start = wordIdx * per_word;
+    if (idx <= start) {
+      return low_;
+    }
+    if (idx - start >= per_word) {
+      return Word_t(0);
+    }
+    const Word_t all = Word_t(~Word_t(0));
+    return Word_t(low_ & Word_t(all >> ((idx - start) * T_Field_Bits)));
+  }
+
+  /* the fields of word $wordIdx in [begin, end) */
+  static constexpr Word_t
+  range(size_t wordIdx, size_t begin, size_t end) noexcept {
+    return Word_t(window(wordIdx, begin) & Word_t(~window(wordIdx, end)));
+  }
+
+  /* index of the most significant field marked in $found, != 0 */
+  static size_t
+  first(Word_t found) noexcept {
+#if defined(__GNUC__)
+    const size_t lz = size_t(__builtin_clzll((unsigned long long)found)) -
+                      (64 - bits);
+#else
+    size_t lz(0);
+    while (Word_t(found & Word_t(Word_t(1) << (bits - 1 - lz))) == 0) {
+      ++lz;
+    }
+#endif
+    return lz / T_Field_Bits;
+  }
+
+  static size_t
+  popcount(Word_t word) noexcept {
+    return std::bitset<bits>((unsigned long long)word).count();
+  }
+};
+
+} // namespace sp
+
+#endif
@@ -0,0 +1,180 @@
+#include "FieldArray.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using sp::FieldArray;
+
+enum State : uint8_t { FREE = 0, RESERVED = 1, LIVE = 2, DRAINING = 3 };
+
+class FieldArrayTest : public ::testing::Test {};
+
+template <size_t width, typename T>
+void
+test_get_set() {
+  constexpr size_t fields(1000);
+  constexpr uint8_t values = uint8_t(1) << width;
+  FieldArray<fields, width, T> fa;
+  std::vector<uint8_t> ref(fields, 0);
+  std::mt19937 mt(0);
+  std::uniform_int_distribution<int> dist(0, values - 1);
+
+  for (size_t i = 0; i < fields; ++i) {
+    ref[i] = uint8_t(dist(mt));
+    ASSERT_EQ(0, fa.set(i, ref[i]));
+  }
+  for (size_t i = 0; i < fields; ++i) {
+    ASSERT_EQ(ref[i], fa.get(i));
+  }
+  for (uint8_t v = 0; v < values; ++v) {
+    size_t expected(0);
+    for (size_t i = 0; i < fields; ++i) {
+      expected += ref[i] == v ? 1 : 0;
+    }
+    ASSERT_EQ(expected, fa.count(v));
+  }
+}
+
+TEST_F(FieldArrayTest, test_get_set_2_long) {
+  test_get_set<2, uint64_t>();
+}
+
+TEST_F(FieldArrayTest, test_get_set_4_long) {
+  test_get_set<4, uint64_t>();
+}
+
+TEST_F(FieldArrayTest, test_get_set_2_byte) {
+  test_get_set<2, uint8_t>();
+}
+
+TEST_F(FieldArrayTest, test_get_set_4_short) {
+  test_get_set<4, uint16_t>();
+}
+
+template <size_t width, typename T>
+void
+test_find_first_field() {
+  constexpr size_t fields(1000);
+  FieldArray<fields, width, T> fa(FREE);
+  ASSERT_EQ(fa.npos, fa.find_first_field(LIVE));
+  for (size_t i = fields; i-- > 0;) {
+    ASSERT_TRUE(fa.compare_and_set_field(i, FREE, LIVE));
+    ASSERT_FALSE(fa.compare_and_set_field(i, FREE, LIVE));
+    ASSERT_EQ(i, fa.find_first_field(LIVE));
+    ASSERT_EQ(i, fa.find_first_field(i, LIVE));
+    ASSERT_EQ(i == 0 ? fa.npos : size_t(0), fa.find_first_field(FREE));
+  }
+  ASSERT_EQ(fa.npos, fa.find_first_field(FREE));
+  ASSERT_EQ(fields, fa.count(LIVE));
+}
+
+TEST_F(FieldArrayTest, test_find_first_field_2) {
+  test_find_first_field<2, uint64_t>();
+}
+
+TEST_F(FieldArrayTest, test_find_first_field_4) {
+  test_find_first_field<4, uint32_t>();
+}
+
+TEST_F(FieldArrayTest, test_swap_first_field) {
+  constexpr size_t fields(300);
+  FieldArray<fields> fa(FREE);
+  for (size_t i = 0; i < fields; ++i) {
+    ASSERT_EQ(i, fa.swap_first_field(FREE, RESERVED));
+  }
+  ASSERT_EQ(fa.npos, fa.swap_first_field(FREE, RESERVED));
+  ASSERT_EQ(size_t(10), fa.swap_first_field(10, RESERVED, LIVE));
+  ASSERT_EQ(LIVE, fa.get(10));
+  ASSERT_EQ(RESERVED, fa.get(9));
+}
+
+TEST_F(FieldArrayTest, test_out_of_range) {
+  FieldArray<64, 2> fa(FREE);
+  // values are truncated to the field width, neighbours are untouched
+  ASSERT_EQ(FREE, fa.set(5, 7));
+  ASSERT_EQ(FREE, fa.get(4));
+  ASSERT_EQ(DRAINING, fa.get(5));
+  ASSERT_EQ(FREE, fa.get(6));
+
+  // 4 is FREE when truncated, so nothing changes
+  ASSERT_FALSE(fa.compare_and_set_field(9, FREE, 4));
+  ASSERT_EQ(FREE, fa.get(8));
+  ASSERT_EQ(FREE, fa.get(9));
+  ASSERT_EQ(FREE, fa.get(10));
+  ASSERT_TRUE(fa.compare_and_set_field(9, FREE, 6));
+  ASSERT_EQ(FREE, fa.get(8));
+  ASSERT_EQ(LIVE, fa.get(9));
+  // compared values are truncated as well, 6 is LIVE
+  ASSERT_EQ(size_t(9), fa.find_first_field(6));
+  ASSERT_EQ(size_t(1), fa.count(6));
+  ASSERT_TRUE(fa.compare_and_set_field(9, 6, RESERVED));
+  ASSERT_EQ(RESERVED, fa.get(9));
+  ASSERT_TRUE(fa.compare_and_set_field(9, 5, FREE));
+  ASSERT_EQ(FREE, fa.get(9));
+
+  ASSERT_EQ(size_t(0), fa.swap_first_field(FREE, 13));
+  ASSERT_EQ(RESERVED, fa.get(0));
+  ASSERT_EQ(FREE, fa.get(1));
+
+  FieldArray<16, 4, uint16_t> wide(0);
+  ASSERT_EQ(0, wide.set(2, 0x1f));
+  ASSERT_EQ(0, wide.get(1));
+  ASSERT_EQ(0xf, wide.get(2));
+  ASSERT_EQ(0, wide.get(3));
+
+  // indices out of range change nothing
+  ASSERT_EQ(FREE, fa.set(64, LIVE));
+  ASSERT_EQ(FREE, fa.set(1000, LIVE));
+  ASSERT_EQ(FREE, fa.get(64));
+  ASSERT_FALSE(fa.compare_and_set_field(64, FREE, LIVE));
+  ASSERT_EQ(size_t(2), fa.count(LIVE) + fa.count(DRAINING) +
+                           fa.count(RESERVED));
+}
+
+TEST_F(FieldArrayTest, test_transition) {
+  constexpr size_t fields(1000);
+  FieldArray<fields, 2, uint64_t> fa(LIVE);
+  for (size_t i = 0; i < fields; i += 3) {
+    fa.set(i, FREE);
+  }
+  const size_t live = fa.count(LIVE);
+  // a partial range on both edges
+  ASSERT_EQ(size_t(2), fa.transition(1, 4, LIVE, DRAINING));
+  ASSERT_EQ(FREE, fa.get(0));
+  ASSERT_EQ(DRAINING, fa.get(1));
+  ASSERT_EQ(DRAINING, fa.get(2));
+  ASSERT_EQ(FREE, fa.get(3));
+  ASSERT_EQ(LIVE, fa.get(4));
+
+  ASSERT_EQ(live - 2, fa.transition(LIVE, DRAINING));
+  ASSERT_EQ(size_t(0), fa.count(LIVE));
+  ASSERT_EQ(live, fa.count(DRAINING));
+  ASSERT_EQ(fields - live, fa.count(FREE));
+}
+
+TEST_F(FieldArrayTest, test_threaded) {
+  constexpr size_t fields(1024);
+  FieldArray<fields> fa(FREE);
+  std::atomic<size_t> reserved(0);
+  auto worker = [&] {
+    while (true) {
+      size_t idx = fa.swap_first_field(FREE, RESERVED);
+      if (idx == fa.npos) {
+        break;
+      }
+      ++reserved;
+      ASSERT_TRUE(fa.compare_and_set_field(idx, RESERVED, LIVE));
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(fields, reserved.load());
+  ASSERT_EQ(fields, fa.count(LIVE));
+}
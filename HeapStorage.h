@@ -0,0 +1,199 @@
+#ifndef SP_CONCURRENT_HEAP_STORAGE_H
+#define SP_CONCURRENT_HEAP_STORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace sp {
+
+enum class HugePages {
+  // regular pages
+  None,
+  // transparent huge pages using madvise(MADV_HUGEPAGE)
+  Advise,
+  // explicit hugetlb pages using MAP_HUGETLB, falling back to Advise when no
+  // huge pages are reserved
+  Explicit
+};
+
+/**
+ * Storage policy of Bitset placing the words on the heap, aligned to
+ * $T_Align bytes, or to 2MB when huge pages are used. The words are mapped
+ * anonymously, so pages are faulted in on first touch unless $T_Prefault is
+ * set, which faults them in at construction instead of on the request path.
+ *
+ * Mappings and huge pages are only available on linux, other platforms fall
+ * back to aligned operator new which always touches the memory.
+ */
+template <size_t T_Align = 64, HugePages T_Huge = HugePages::None,
+          bool T_Prefault = false>
+struct HeapStorage {
+  static constexpr bool heap = true;
+  static constexpr bool external = false;
+  static constexpr size_t page = 4096;
+  static constexpr size_t huge_page = size_t(2) * 1024 * 1024;
+  static constexpr size_t alignment =
+      T_Huge == HugePages::None || T_Align > huge_page ? T_Align : huge_page;
+
+  static_assert(T_Align != 0 && (T_Align & (T_Align - 1)) == 0,
+                "Alignment is required to be a power of two");
+
+  template <typename T, size_t T_Count>
+  class Array {
+  private:
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Elements are required to be trivially destructible");
+
+    static constexpr size_t bytes = sizeof(T) * T_Count;
+    static constexpr size_t granule = alignment > page ? alignment : page;
+    static constexpr size_t mapped_bytes =
+        ((bytes + granule - 1) / granule) * granule;
+
+    T *m_data;
+    void *m_mapping;
+    size_t m_mapping_length;
+
+  public:
+    /**
+     *  @throw  std::bad_alloc  if the memory could not be allocated
+     */
+    Array()
+        : m_data(nullptr)
+        , m_mapping(nullptr)
+        , m_mapping_length(0) {
+      void *raw = nullptr;
+#if defined(__linux__)
+      raw = map();
+#endif
+      if (raw == nullptr) {
+        raw = ::operator new(bytes, std::align_val_t(alignment));
+        // operator new memory is not zeroed, which also faults it in
+        std::memset(raw, 0, bytes);
+      }
+      m_data = static_cast<T *>(raw);
+    }
+
+    Array(const Array &) = delete;
+    Array(Array &&) = delete;
+
+    Array &
+    operator=(const Array &) = delete;
+    Array &
+    operator=(Array &&) = delete;
+
+    ~Array() noexcept {
+#if defined(__linux__)
+      if (m_mapping != nullptr) {
+        ::munmap(m_mapping, m_mapping_length);
+        return;
+      }
+#endif
+      ::operator delete(static_cast<void *>(m_data),
+                        std::align_val_t(alignment));
+    }
+
+    T &operator[](size_t idx) noexcept {
+      return m_data[idx];
+    }
+
+    const T &operator[](size_t idx) const noexcept {
+      return m_data[idx];
+    }
+
+    T *
+    data() noexcept {
+      return m_data;
+    }
+
+    const T *
+    data() const noexcept {
+      return m_data;
+    }
+
+    constexpr size_t
+    size() const noexcept {
+      return T_Count;
+    }
+
+  private:
+#if defined(__linux__)
+    /**
+     * anonymous mappings are zero filled, which is the value initialised
+     * state of the integral atomics stored here, so the elements are not
+     * constructed and the pages are only touched when prefaulting
+     */
+    void *
+    map() noexcept {
+      const int populate = T_Prefault ? MAP_POPULATE : 0;
+#if defined(MAP_HUGETLB)
+      if (T_Huge == HugePages::Explicit) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate;
+#if defined(MAP_HUGE_2MB)
+        flags |= MAP_HUGE_2MB;
+#endif
+        void *res = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE,
+                           flags, -1, 0);
+        if (res != MAP_FAILED) {
+          m_mapping = res;
+          m_mapping_length = mapped_bytes;
+          return res;
+        }
+      }
+#endif
+      // mappings are page aligned, over allocate to align to more than that
+      const size_t length = mapped_bytes + (alignment > page ? alignment : 0);
+      void *res = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (res == MAP_FAILED) {
+        return nullptr;
+      }
+      const uintptr_t base = reinterpret_cast<uintptr_t>(res);
+      const uintptr_t aligned = (base + granule - 1) & ~(granule - 1);
+      if (aligned > base) {
+        ::munmap(res, aligned - base);
+      }
+      const uintptr_t tail = aligned + mapped_bytes;
+      if (base + length > tail) {
+        ::munmap(reinterpret_cast<void *>(tail), base + length - tail);
+      }
+      m_mapping = reinterpret_cast<void *>(aligned);
+      m_mapping_length = mapped_bytes;
+
+#if defined(MADV_HUGEPAGE)
+      if (T_Huge != HugePages::None) {
+        // failure only means regular pages are used
+        ::madvise(m_mapping, m_mapping_length, MADV_HUGEPAGE);
+      }
+#endif
+      if (T_Prefault) {
+        prefault(m_mapping, m_mapping_length);
+      }
+      return m_mapping;
+    }
+
+    static void
+    prefault(void *start, size_t length) noexcept {
+#if defined(MADV_POPULATE_WRITE)
+      if (::madvise(start, length, MADV_POPULATE_WRITE) == 0) {
+        return;
+      }
+#endif
+      volatile char *cursor = static_cast<char *>(start);
+      for (size_t off = 0; off < length; off += page) {
+        cursor[off] = 0;
+      }
+    }
+#endif
+  };
+};
+
+} // namespace sp
+
+#endif
@@ -0,0 +1,72 @@
+#include "Bitset.h"
+#include "HeapStorage.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <memory>
+
+using sp::Bitset;
+using sp::HeapStorage;
+using sp::HugePages;
+
+class HeapStorageTest : public ::testing::TestWithParam<bool> {};
+
+INSTANTIATE_TEST_CASE_P(PreFill, HeapStorageTest,
+                        ::testing::Values(true, false));
+
+template <typename Storage>
+void
+test_alignment() {
+  using Array_t =
+      typename Storage::template Array<std::atomic<uint64_t>, 1024 * 64>;
+  Array_t arr;
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(arr.data());
+  ASSERT_EQ(uintptr_t(0), addr % Storage::alignment);
+  for (size_t i = 0; i < arr.size(); ++i) {
+    ASSERT_EQ(uint64_t(0), arr[i].load());
+  }
+}
+
+TEST_F(HeapStorageTest, test_alignment_line) {
+  test_alignment<HeapStorage<64>>();
+}
+
+TEST_F(HeapStorageTest, test_alignment_advise) {
+  test_alignment<HeapStorage<64, HugePages::Advise>>();
+}
+
+TEST_F(HeapStorageTest, test_alignment_explicit_prefault) {
+  test_alignment<HeapStorage<64, HugePages::Explicit, true>>();
+}
+
+template <typename Storage>
+void
+test_heap_bitset(bool v) {
+  constexpr size_t bits(1024 * 1024 * 32);
+  using Bitset_t = Bitset<bits, uint64_t, sp::Untracked, Storage>;
+  auto bb = std::make_unique<Bitset_t>(!v);
+  ASSERT_LT(sizeof(Bitset_t), size_t(64));
+  ASSERT_TRUE(bb->all(!v));
+  ASSERT_EQ(bb->npos, bb->find_first(v));
+
+  for (size_t i = 0; i < bits; i += 4099) {
+    ASSERT_EQ(i, bb->swap_first(i, v));
+  }
+  ASSERT_EQ(size_t(0), bb->find_first(v));
+  ASSERT_EQ(v ? (bits + 4098) / 4099 : bits - (bits + 4098) / 4099,
+            bb->count(sp::Parallel(4)));
+}
+
+TEST_P(HeapStorageTest, test_bitset_line) {
+  test_heap_bitset<HeapStorage<64>>(GetParam());
+}
+
+TEST_P(HeapStorageTest, test_bitset_huge) {
+  test_heap_bitset<HeapStorage<64, HugePages::Advise, true>>(GetParam());
+}
+
+TEST_F(HeapStorageTest, test_bitset_default) {
+  Bitset<1024 * 64, uint32_t, sp::Untracked, HeapStorage<>> bb;
+  ASSERT_TRUE(bb.all(false));
+  ASSERT_TRUE(bb.set(100, true));
+  ASSERT_EQ(size_t(100), bb.find_first(true));
+}
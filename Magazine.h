@@ -0,0 +1,150 @@
+#ifndef SP_CONCURRENT_MAGAZINE_H
+#define SP_CONCURRENT_MAGAZINE_H
+
+#include "Bitset.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace sp {
+
+/**
+ * Single thread cache of bits claimed from a shared Bitset. Bits are claimed
+ * from the shared set in batches, one CAS per word, and are afterwards
+ * acquired and released locally without touching the shared cache lines.
+ * When the number of cached bits reaches the high-water mark half of them are
+ * spilled back to the shared set. All cached bits are returned on destruction,
+ * so declaring the Magazine thread_local flushes it on thread exit.
+ *
+ * A Magazine is not thread safe and should be owned by a single thread.
+ */
+template <typename Bitset_t, size_t T_Capacity = 64>
+class Magazine {
+public:
+  static constexpr size_t npos = Bitset_t::npos;
+
+private:
+  static_assert(T_Capacity > 1, "Capacity is required to be at least 2");
+
+  Bitset_t &m_shared;
+  // the value a bit in the shared set has when it is acquired
+  const bool m_set;
+  const size_t m_high_water;
+  // where the next refill starts to search
+  size_t m_cursor;
+  size_t m_length;
+  std::array<size_t, T_Capacity> m_cache;
+
+public:
+  /**
+   *  @param  shared     the bitset to claim bits from
+   *  @param  set        the value a bit is swapped to when acquired
+   *  @param  highWater  number of cached bits which triggers a spill
+   */
+  Magazine(Bitset_t &shared, bool set, size_t highWater = T_Capacity) noexcept
+      : m_shared(shared)
+      , m_set(set)
+      , m_high_water(highWater < 2 || highWater > T_Capacity ? T_Capacity
+                                                             : highWater)
+      , m_cursor(0)
+      , m_length(0)
+      , m_cache() {
+  }
+
+  Magazine(const Magazine &) = delete;
+  Magazine(Magazine &&) = delete;
+
+  Magazine &
+  operator=(const Magazine &) = delete;
+  Magazine &
+  operator=(Magazine &&) = delete;
+
+  ~Magazine() noexcept {
+    flush();
+  }
+
+  /**
+   *  @brief acquires a bit, refilling from the shared set if empty
+   *  @return the index of the acquired bit or npos if the shared set is
+   *          exhausted
+   */
+  size_t
+  acquire() noexcept {
+    if (m_length == 0) {
+      refill(m_high_water / 2);
+      if (m_length == 0) {
+        return npos;
+      }
+    }
+    return m_cache[--m_length];
+  }
+
+  /**
+   *  @brief releases a previously acquired bit into the local cache, spilling
+   *         to the shared set if the high-water mark is reached
+   */
+  void
+  release(size_t bitIdx) noexcept {
+    if (m_length >= m_high_water) {
+      spill(m_high_water / 2);
+    }
+    m_cache[m_length++] = bitIdx;
+  }
+
+  /**
+   *  @brief returns all cached bits to the shared set
+   */
+  void
+  flush() noexcept {
+    spill(m_length);
+  }
+
+  size_t
+  cached() const noexcept {
+    return m_length;
+  }
+
+private:
+  void
+  refill(size_t target) noexcept {
+    const size_t start = m_cursor;
+    size_t idx = start;
+    bool wrapped = false;
+    while (m_length < target) {
+      const size_t limit = wrapped ? start : m_shared.size();
+      const size_t max = target - m_length;
+      const size_t cnt =
+          m_shared.swap_batch(idx, m_set, limit, &m_cache[m_length], max);
+      if (cnt == 0) {
+        if (wrapped || start == 0) {
+          break;
+        }
+        wrapped = true;
+        idx = 0;
+        continue;
+      }
+      m_length += cnt;
+      idx = m_cache[m_length - 1] + 1;
+    }
+    m_cursor = idx < m_shared.size() ? idx : 0;
+  }
+
+  /**
+   * the oldest cached bits are spilled, keeping the most recently released
+   * and therefore hottest bits local
+   */
+  void
+  spill(size_t cnt) noexcept {
+    cnt = std::min(cnt, m_length);
+    for (size_t i = 0; i < cnt; ++i) {
+      m_shared.set(m_cache[i], !m_set);
+    }
+    std::copy(m_cache.begin() + cnt, m_cache.begin() + m_length,
+              m_cache.begin());
+    m_length -= cnt;
+  }
+};
+
+} // namespace sp
+
+#endif
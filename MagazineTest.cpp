@@ -0,0 +1,105 @@
+#include "Magazine.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using sp::Bitset;
+using sp::Magazine;
+
+class MagazineTest : public ::testing::TestWithParam<bool> {};
+
+INSTANTIATE_TEST_CASE_P(Set, MagazineTest, ::testing::Values(true, false));
+
+template <typename T>
+void
+test_acquire_all(bool v) {
+  constexpr size_t bits(1024);
+  Bitset<bits, T> bb{!v};
+  {
+    Magazine<Bitset<bits, T>, 16> mag(bb, v);
+    std::unordered_set<size_t> present;
+    for (size_t i = 0; i < bits; ++i) {
+      size_t idx = mag.acquire();
+      ASSERT_LT(idx, bits);
+      ASSERT_TRUE(present.insert(idx).second);
+      ASSERT_EQ(v, bb.test(idx));
+    }
+    ASSERT_EQ(mag.npos, mag.acquire());
+    ASSERT_TRUE(bb.all(v));
+
+    for (size_t idx : present) {
+      mag.release(idx);
+      ASSERT_LE(mag.cached(), size_t(16));
+    }
+    ASSERT_FALSE(bb.all(v));
+  }
+  // destruction flushes the cached bits
+  ASSERT_TRUE(bb.all(!v));
+}
+
+TEST_P(MagazineTest, test_acquire_all_long) {
+  test_acquire_all<uint64_t>(GetParam());
+}
+
+TEST_P(MagazineTest, test_acquire_all_byte) {
+  test_acquire_all<uint8_t>(GetParam());
+}
+
+TEST_P(MagazineTest, test_release_local) {
+  constexpr size_t bits(1024);
+  const bool v = GetParam();
+  Bitset<bits, uint64_t> bb{!v};
+  Magazine<Bitset<bits, uint64_t>, 16> mag(bb, v);
+
+  size_t idx = mag.acquire();
+  ASSERT_LT(idx, bits);
+  mag.release(idx);
+  // the bit stays claimed in the shared set while cached
+  ASSERT_EQ(v, bb.test(idx));
+  ASSERT_EQ(idx, mag.acquire());
+  mag.flush();
+  ASSERT_EQ(size_t(0), mag.cached());
+}
+
+TEST_F(MagazineTest, test_threaded) {
+  constexpr size_t bits(1024 * 8);
+  using Bitset_t = Bitset<bits, uint64_t>;
+  Bitset_t bb{false};
+  std::vector<std::atomic<int>> owners(bits);
+  std::atomic<bool> failed(false);
+
+  auto worker = [&] {
+    thread_local Magazine<Bitset_t, 32> mag(bb, true);
+    std::vector<size_t> held;
+    for (size_t round = 0; round < 2000; ++round) {
+      for (size_t i = 0; i < 24; ++i) {
+        size_t idx = mag.acquire();
+        if (idx == mag.npos) {
+          break;
+        }
+        if (owners[idx].fetch_add(1) != 0) {
+          failed = true;
+        }
+        held.push_back(idx);
+      }
+      for (size_t idx : held) {
+        owners[idx].fetch_sub(1);
+        mag.release(idx);
+      }
+      held.clear();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_FALSE(failed.load());
+  // thread exit flushes each thread_local magazine
+  ASSERT_TRUE(bb.all(false));
+}